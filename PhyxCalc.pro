@@ -63,6 +63,12 @@ osx {
 
 CONFIG += c++11
 
+# floating point type of the calculator core, CONFIG+=phyx_double trades the
+# extended precision of long double for faster, vectorizable double arithmetic
+phyx_double {
+    DEFINES += PHYX_FLOAT_DOUBLE
+}
+
 SOURCES += main.cpp\
         mainwindow.cpp \
         lineparser.cpp \
@@ -80,7 +86,9 @@ SOURCES += main.cpp\
     phyxsyntaxhighlighter.cpp \
     helpdialog.cpp \
     plotwindow.cpp \
-    plotdialog.cpp
+    plotdialog.cpp \
+    phyxbatchplan.cpp \
+    phyxdocumentevaluator.cpp
 
 HEADERS  += mainwindow.h \
             lineparser.h \
@@ -99,7 +107,9 @@ HEADERS  += mainwindow.h \
     phyxsyntaxhighlighter.h \
     helpdialog.h \
     plotwindow.h \
-    plotdialog.h
+    plotdialog.h \
+    phyxbatchplan.h \
+    phyxdocumentevaluator.h
 
 FORMS    += mainwindow.ui \
     exportdialog.ui \
@@ -37,7 +37,8 @@
 #define _BIG_ENDIAN
 #endif
 
-#ifndef Q_OS_SYMBIAN
+//long double unless the platform or the build (CONFIG+=phyx_double) asks for double
+#if !defined(Q_OS_SYMBIAN) && !defined(PHYX_FLOAT_DOUBLE)
 #define PHYX_FLOAT_NULL 0.0L
 #define PHYX_FLOAT_ONE 1.0L
 #define PHYX_FLOAT_TWO 2.0L
@@ -47,6 +48,8 @@
 #define FRACTION_MAX 1.0e-19L
 #define FRACTION_MIN 1.0e+19L
 #define FRACTION_BIGGEST 999999999999999999.0L
+#define PHYX_FLOAT_PRINTF_LENGTH "L"
+#define PHYX_INTEGER_EXACT_LIMIT 9007199254740992.0L
 typedef long double                 PhyxFloatDataType;      /// the data type for floating point variables
 #else
 #define PHYX_FLOAT_NULL 0.0
@@ -58,9 +61,11 @@ typedef long double                 PhyxFloatDataType;      /// the data type fo
 #define FRACTION_MAX 1.0e-19
 #define FRACTION_MIN 1.0e+19
 #define FRACTION_BIGGEST 999999999999999999.0
+#define PHYX_FLOAT_PRINTF_LENGTH ""
+#define PHYX_INTEGER_EXACT_LIMIT 9007199254740992.0
 typedef double                      PhyxFloatDataType;      /// the data type for floating point variables
 #endif
-typedef long int                    PhyxIntegerDataType;    /// the data type for integers
+typedef qint64                      PhyxIntegerDataType;    /// the data type for integers, 64 bit on every platform so exact integers reach PHYX_INTEGER_EXACT_LIMIT
 
 //structure for colorScheme Items
 typedef struct {
@@ -19,10 +19,14 @@
 
 #include "lineparser.h"
 
-LineParser::LineParser(QObject *)
+LineParser::LineParser(QObject *, QSharedPointer<PhyxCalculator> baseCalculator)
 {
     m_loading = true;
-    m_phyxCalculator = new PhyxCalculator(this);
+    m_datasetProgressDialog = NULL;
+    if (baseCalculator.isNull())
+        m_phyxCalculator = new PhyxCalculator(this);
+    else
+        m_phyxCalculator = new PhyxCalculator(baseCalculator, this);
     connect(m_phyxCalculator, SIGNAL(outputResult()),
             this, SLOT(outputResult()));
     connect(m_phyxCalculator, SIGNAL(outputError()),
@@ -45,6 +49,8 @@ LineParser::LineParser(QObject *)
             this, SLOT(updateDatasets()));
     connect(m_phyxCalculator,SIGNAL(datasetsChanged()),
             this, SLOT(showPlotWindow()));
+    connect(m_phyxCalculator, SIGNAL(datasetProgress(int,int)),
+            this, SLOT(showDatasetProgress(int,int)));
 }
 
 LineParser::~LineParser()
@@ -53,17 +59,27 @@ LineParser::~LineParser()
 
 void LineParser::parseLine(bool linebreak)
 {
+    if (m_phyxCalculator->isCalculatingDataset())  //the calculator keeps the gui alive while calculating datasets
+        return;
+
     replaceSymbols();     //replace greek units
     int previousPosition = m_calculationEdit->textCursor().position();  //save cursor position
 
     QString curLineText = getCurrentLine();     //read current line
+    QTextBlock block = m_calculationEdit->textCursor().block();    //the output moves the cursor
+    block.setUserData(NULL);    //a line that is not evaluated must not keep the dependencies of its previous text
     if (curLineText.isEmpty() || !(curLineText.at(0) == '='))
     {
         if (!commentLineSelected())
         {
             m_phyxCalculator->setExpression(curLineText);
             if (!m_phyxCalculator->expression().isEmpty())
+            {
                 m_phyxCalculator->evaluate();
+                block.setUserData(new LineDependencies(curLineText,
+                                                       m_phyxCalculator->readSymbols(),
+                                                       m_phyxCalculator->writtenSymbols()));
+            }
         }
     }
 
@@ -88,6 +104,9 @@ void LineParser::parseAll()
 
 void LineParser::parseFromCurrentPosition()
 {
+    if (m_phyxCalculator->isCalculatingDataset())
+        return;
+
     QTextCursor textCursor = m_calculationEdit->textCursor();
     textCursor.movePosition(QTextCursor::StartOfBlock, QTextCursor::MoveAnchor);
     m_calculationEdit->setTextCursor(textCursor);
@@ -101,6 +120,149 @@ void LineParser::parseFromCurrentPosition()
     }
 }
 
+void LineParser::parseChanged()
+{
+    if (m_phyxCalculator->isCalculatingDataset())
+        return;
+
+    QTextCursor previousCursor = m_calculationEdit->textCursor();   //follows the inserted output lines
+
+    QList<QTextBlock>       blocks;
+    QList<QSet<QString> >   reads;
+    QList<QSet<QString> >   writes;
+    QList<bool>             changed;
+    QHash<QString, QList<int> > writers;    //the lines defining a symbol in document order
+    bool inComment = false;                 //inside a multi line comment, tracked here so the cursor is only moved to recalculated lines
+
+    for (QTextBlock block = m_calculationEdit->document()->begin(); block.isValid(); block = block.next())
+    {
+        QString text = block.text().trimmed();
+
+        if (inComment)
+        {
+            if (!text.contains("*/"))
+                continue;
+            inComment = false;
+        }
+        if (text.isEmpty() || (text.at(0) == '='))
+            continue;
+
+        int commentStart = text.lastIndexOf("/*");
+        if ((commentStart != -1) && (text.indexOf("*/", commentStart) == -1))
+            inComment = true;
+
+        LineDependencies *dependencies = static_cast<LineDependencies*>(block.userData());
+        if ((dependencies == NULL) && PhyxCalculator::stripComments(text).trimmed().isEmpty())
+            continue;   //a comment only line is never evaluated
+
+        blocks.append(block);
+        if (dependencies != NULL)
+        {
+            reads.append(dependencies->readSymbols);
+            writes.append(dependencies->writtenSymbols);
+            changed.append(dependencies->expression != text);
+        }
+        else
+        {
+            reads.append(QSet<QString>());
+            writes.append(QSet<QString>());
+            changed.append(true);
+        }
+
+        foreach (const QString &symbol, writes.last())
+            writers[symbol].append(blocks.size() - 1);
+    }
+
+    //the calculator holds the values of the last full run, so a line reading a redefined
+    //symbol needs its previous definition restored first, and the last definition has to
+    //be restored at the end; repeat until no further line is pulled in
+    QVector<bool> recalculate(blocks.size(), false);
+    bool replan = true;
+    while (replan)
+    {
+        replan = false;
+
+        QHash<QString, int> holder;     //the line whose value a symbol currently has
+        QHashIterator<QString, QList<int> > writersIterator(writers);
+        while (writersIterator.hasNext())
+        {
+            writersIterator.next();
+            holder.insert(writersIterator.key(), writersIterator.value().last());
+        }
+
+        QSet<QString> dirty;            //symbols whose value differs from the last run
+        for (int i = 0; i < blocks.size(); i++)
+        {
+            bool inputsChanged = changed.at(i) || reads.at(i).intersects(dirty);
+            if (inputsChanged)
+                recalculate[i] = true;
+
+            if (recalculate.at(i))
+            {
+                //a changed line may read anything, so restore every redefined symbol
+                QList<QString> required = changed.at(i) ? holder.keys() : reads.at(i).toList();
+                foreach (const QString &symbol, required)
+                {
+                    int writer = -1;
+                    foreach (int line, writers.value(symbol))
+                    {
+                        if (line < i)
+                            writer = line;
+                    }
+
+                    if ((writer != -1) && (holder.value(symbol) != writer) && !recalculate.at(writer))
+                    {
+                        recalculate[writer] = true;
+                        replan = true;
+                    }
+                }
+
+                foreach (const QString &symbol, writes.at(i))
+                {
+                    holder.insert(symbol, i);
+                    if (inputsChanged)
+                        dirty.insert(symbol);
+                    else
+                        dirty.remove(symbol);
+                }
+            }
+            else
+                dirty.subtract(writes.at(i));
+        }
+
+        QHashIterator<QString, int> holderIterator(holder);
+        while (holderIterator.hasNext())
+        {
+            holderIterator.next();
+            int lastWriter = writers.value(holderIterator.key()).last();
+            if ((holderIterator.value() != lastWriter) && !recalculate.at(lastWriter))
+            {
+                recalculate[lastWriter] = true;
+                replan = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < blocks.size(); i++)
+    {
+        if (!recalculate.at(i))
+            continue;
+
+        m_calculationEdit->setTextCursor(QTextCursor(blocks.at(i)));
+        parseLine(false);
+
+        //a line defining something new may be read by any line after it
+        LineDependencies *dependencies = static_cast<LineDependencies*>(blocks.at(i).userData());
+        if (changed.at(i) && (dependencies != NULL) && !writes.at(i).contains(dependencies->writtenSymbols))
+        {
+            for (int j = i + 1; j < blocks.size(); j++)
+                recalculate[j] = true;
+        }
+    }
+
+    m_calculationEdit->setTextCursor(previousCursor);
+}
+
 void LineParser::replaceSymbols()
 {
     QString curLineText,
@@ -109,10 +271,7 @@ void LineParser::replaceSymbols()
     curLineText = getCurrentLine();
     oldLine = curLineText;
 
-    for (int i = 0; i < m_unitLoader->symbols()->size(); i++)
-    {
-        curLineText.replace(m_unitLoader->symbols()->at(i).name, m_unitLoader->symbols()->at(i).symbol, Qt::CaseSensitive);
-    }
+    curLineText = m_unitLoader->replaceSymbols(curLineText);
 
     //if line not unchanged replace current line
     if (curLineText != oldLine)
@@ -857,6 +1016,20 @@ void LineParser::updateDatasets()
     m_plotWindow->setDatasets(m_phyxCalculator->datasets());
 }
 
+void LineParser::showDatasetProgress(int value, int maximum)
+{
+    if (m_datasetProgressDialog == NULL)
+    {
+        m_datasetProgressDialog = new QProgressDialog(tr("Calculating dataset..."), tr("Cancel"), 0, maximum, m_calculationEdit);
+        m_datasetProgressDialog->setWindowModality(Qt::WindowModal);
+        connect(m_datasetProgressDialog, SIGNAL(canceled()),
+                m_phyxCalculator, SLOT(cancelDataset()));
+    }
+
+    m_datasetProgressDialog->setMaximum(maximum);
+    m_datasetProgressDialog->setValue(value);   //closes the dialog when the dataset is finished
+}
+
 void LineParser::showPlotWindow()
 {
     if (m_appSettings->plot.autoShowPlotWindow)
@@ -25,17 +25,32 @@
 #include <QList>
 #include <QDebug>
 #include <QTextBlock>
+#include <QSet>
+#include <QHash>
 #include <QTextEdit>
 #include <QTableWidgetItem>
 #include <QTableWidget>
 #include <QListWidget>
 #include <QCheckBox>
+#include <QProgressDialog>
 #include "unitloader.h"
 #include "global.h"
 #include "phyxcalculator.h"
 #include "phyxsyntaxhighlighter.h"
 #include "plotwindow.h"
 
+/// stores what the last evaluation of a line depended on and what it defined
+class LineDependencies: public QTextBlockUserData
+{
+public:
+    LineDependencies(const QString &expression, const QSet<QString> &readSymbols, const QSet<QString> &writtenSymbols)
+        : expression(expression), readSymbols(readSymbols), writtenSymbols(writtenSymbols) {}
+
+    QString         expression;         ///< the text of the line when it was evaluated
+    QSet<QString>   readSymbols;        ///< symbols the line read, like "variable:x"
+    QSet<QString>   writtenSymbols;     ///< symbols the line defined or removed
+};
+
 class LineParser: public QObject
 {
     Q_OBJECT
@@ -53,12 +68,13 @@ class LineParser: public QObject
     Q_PROPERTY(bool loading READ isLoading WRITE setLoading)
 
 public:
-    explicit LineParser(QObject * = 0);
+    explicit LineParser(QObject * = 0, QSharedPointer<PhyxCalculator> baseCalculator = QSharedPointer<PhyxCalculator>());   ///< the calculator shares the grammar and definitions of baseCalculator if one is given
     ~LineParser();
 
     void parseLine(bool linebreak);
     void parseAll();
     void parseFromCurrentPosition();
+    void parseChanged();        ///< recalculates the changed lines and the lines depending on them
 
     void insertNewLine(bool force = false);
     void deleteLine();
@@ -136,6 +152,7 @@ private:
     UnitLoader      *m_unitLoader;
     PhyxCalculator  *m_phyxCalculator;
     PhyxSyntaxHighlighter * m_syntaxHighlighter;
+    QProgressDialog *m_datasetProgressDialog;
 
     /* Replace greek letters written out with the symbols */
     void replaceSymbols();
@@ -176,6 +193,7 @@ public slots:
     void outputError();
     void outputText(QString text);
     void outputConverted(QString text);
+    void showDatasetProgress(int value, int maximum);
 
     void setCalculationEdit(QTextEdit * arg)
     {
@@ -558,6 +558,7 @@ void MainWindow::initializeGUI()
     ui->actionPaste->setIcon(QIcon::fromTheme("edit-paste",QIcon(":/icons/edit-paste")));
     //ui->actionPhyxCalc
     ui->actionRecalculate_All->setIcon(QIcon::fromTheme("run-build",QIcon(":/icons/run-build")));
+    ui->actionRecalculate_Changed->setIcon(QIcon::fromTheme("run-build",QIcon(":/icons/run-build")));
     ui->actionRecalculate_from_Line->setIcon(QIcon::fromTheme("run-build-cursor",QIcon(":/icons/run-build-cursor")));
     ui->actionRedo->setIcon(QIcon::fromTheme("edit-redo",QIcon(":/icons/edit-redo")));
     ui->actionSave->setIcon(QIcon::fromTheme("document-save",QIcon(":/icons/document-save")));
@@ -628,9 +629,21 @@ void MainWindow::addNewTab()
 
     activeTab = documentList.size();
 
+    // grammar and definitions are loaded once, the compiled snapshot skips rebuilding them, it is rebuilt when one of the sources changes
+    if (baseCalculator.isNull())
+    {
+        baseCalculator = QSharedPointer<PhyxCalculator>(new PhyxCalculator());
+        QStringList snapshotSources = QStringList() << ":/settings/grammar" << settingsDir + "/definitions.txt";
+        if (!baseCalculator->loadSnapshot(settingsDir + "/definitions.snapshot", snapshotSources))
+        {
+            baseCalculator->loadFile(settingsDir + "/definitions.txt");
+            baseCalculator->saveSnapshot(settingsDir + "/definitions.snapshot", snapshotSources);
+        }
+    }
+
     Document *newDocument = new Document;
     newDocument->expressionEdit = new QTextEdit(newTab);
-    newDocument->lineParser = new LineParser(this);
+    newDocument->lineParser = new LineParser(this, baseCalculator);     //every document only copies the definitions it changes
     newDocument->lineParser->setUnitLoader(unitLoader);
     newDocument->lineParser->setVariableTable(ui->variableTable);
     newDocument->lineParser->setConstantsTable(ui->constantsTable);
@@ -640,7 +653,7 @@ void MainWindow::addNewTab()
     newDocument->lineParser->setCalculationEdit(newDocument->expressionEdit);
     newDocument->lineParser->setPlotWindow(plotWindow);
     newDocument->lineParser->setAppSettings(&appSettings);
-    newDocument->lineParser->phyxCalculator()->loadFile(settingsDir + "/definitions.txt");
+
     newDocument->name = "";
     newDocument->path = "";
     documentList.append(newDocument);
@@ -1252,6 +1265,11 @@ void MainWindow::on_actionRecalculate_All_triggered()
     documentList.at(activeTab)->lineParser->parseAll();
 }
 
+void MainWindow::on_actionRecalculate_Changed_triggered()
+{
+    documentList.at(activeTab)->lineParser->parseChanged();
+}
+
 void MainWindow::on_actionRecalculate_from_Line_triggered()
 {
     documentList.at(activeTab)->lineParser->parseFromCurrentPosition();
@@ -83,6 +83,7 @@ private:
 
     QList<Document*> documentList;
     UnitLoader      *unitLoader;
+    QSharedPointer<PhyxCalculator> baseCalculator;  /// grammar and definitions shared by the calculators of all documents
     int             activeTab;
     AppSettings     appSettings;
     QStringList     recentDocuments;
@@ -145,6 +146,7 @@ private slots:
     void on_actionPaste_triggered();
     void on_actionClose_Other_triggered();
     void on_actionRecalculate_All_triggered();
+    void on_actionRecalculate_Changed_triggered();
     void on_actionRecalculate_from_Line_triggered();
     void on_action_Slim_Mode_triggered();
     void on_actionClear_Variables_triggered();
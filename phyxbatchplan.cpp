@@ -0,0 +1,306 @@
+/**************************************************************************
+**
+** This file is part of PhyxCalc.
+**
+** PhyxCalc is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** PhyxCalc is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with PhyxCalc.  If not, see <http://www.gnu.org/licenses/>.
+**
+***************************************************************************/
+
+#include "phyxbatchplan.h"
+
+PhyxBatchPlan::PhyxBatchPlan()
+{
+    clear();
+}
+
+void PhyxBatchPlan::clear()
+{
+    m_steps.clear();
+    m_columnCount = 0;
+    m_uniformResult = false;
+    m_resultValue = PhyxValueDataType();
+}
+
+void PhyxBatchPlan::appendStep(PhyxBatchPlan::StepType type, int column, PhyxBatchPlan::Kernel kernel, int uniformOperand, PhyxValueDataType value)
+{
+    Step step;
+    step.type = type;
+    step.column = column;
+    step.kernel = kernel;
+    step.uniformOperand = uniformOperand;
+    step.value = value;
+    m_steps.append(step);
+
+    m_columnCount = qMax(m_columnCount, (type == BinaryStep) ? (column + 2) : (column + 1));
+}
+
+void PhyxBatchPlan::setUniformResult(PhyxValueDataType value)
+{
+    m_uniformResult = true;
+    m_resultValue = value;
+}
+
+bool PhyxBatchPlan::run(const PhyxValueDataType *parameters, PhyxValueDataType *result, int count) const
+{
+    if (m_uniformResult)
+    {
+        for (int i = 0; i < count; i++)
+            result[i] = m_resultValue;
+        return true;
+    }
+
+    //the columns are local, every call works on its own samples
+    QVector<PhyxValueColumn> columns(m_columnCount);
+
+    for (int i = 0; i < m_steps.size(); i++)
+    {
+        const Step &step = m_steps.at(i);
+
+        if (step.type == ParameterStep)
+        {
+            PhyxValueColumn &column = columns[step.column];
+            column.resize(count);
+            PhyxValueDataType *values = column.data();
+            for (int j = 0; j < count; j++)
+                values[j] = parameters[j];
+        }
+        else if (step.type == ScaleStep)
+        {
+            PhyxValueDataType *values = columns[step.column].data();
+            PhyxFloatDataType scale = step.value.imag();
+            PhyxFloatDataType offset = step.value.real();
+            for (int j = 0; j < count; j++)
+                values[j] = values[j] * scale + offset;
+        }
+        else if (step.type == UnaryStep)
+        {
+            runUnaryKernel(step.kernel, columns[step.column].data(), count);
+        }
+        else if (step.type == BinaryStep)
+        {
+            const PhyxValueDataType *right;
+            int rightStride = 1;
+            if (step.uniformOperand == 1)
+            {
+                right = &step.value;
+                rightStride = 0;
+            }
+            else
+                right = columns.at(step.column + 1).constData();
+
+            if (step.uniformOperand == 0)
+            {
+                columns[step.column].resize(count);
+                runBinaryKernel(step.kernel, &step.value, 0, right, rightStride, columns[step.column].data(), count);
+            }
+            else
+            {
+                PhyxValueDataType *values = columns[step.column].data();   //the kernels work in place
+                runBinaryKernel(step.kernel, values, 1, right, rightStride, values, count);
+            }
+        }
+        else if (step.type == CheckComplexStep)
+        {
+            const PhyxValueDataType *values = columns.at(step.column).constData();
+            for (int j = 0; j < count; j++)
+            {
+                if (values[j].imag() != PHYX_FLOAT_NULL)
+                    return false;
+            }
+        }
+    }
+
+    const PhyxValueDataType *values = columns.at(0).constData();
+    for (int i = 0; i < count; i++)
+        result[i] = values[i];
+
+    return true;
+}
+
+void PhyxBatchPlan::runUnaryKernel(PhyxBatchPlan::Kernel kernel, PhyxValueDataType *values, int count)
+{
+    switch (kernel)
+    {
+    case NegKernel:     for (int i = 0; i < count; i++) values[i] = -values[i];
+                        break;
+    case SinKernel:     for (int i = 0; i < count; i++) values[i] = sinValue(values[i]);
+                        break;
+    case CosKernel:     for (int i = 0; i < count; i++) values[i] = cosValue(values[i]);
+                        break;
+    case TanKernel:     for (int i = 0; i < count; i++) values[i] = tanValue(values[i]);
+                        break;
+    case SinhKernel:    for (int i = 0; i < count; i++) values[i] = sinhValue(values[i]);
+                        break;
+    case CoshKernel:    for (int i = 0; i < count; i++) values[i] = coshValue(values[i]);
+                        break;
+    case TanhKernel:    for (int i = 0; i < count; i++) values[i] = tanhValue(values[i]);
+                        break;
+    case ExpKernel:     for (int i = 0; i < count; i++) values[i] = expValue(values[i]);
+                        break;
+    case LnKernel:      for (int i = 0; i < count; i++) values[i] = lnValue(values[i]);
+                        break;
+    case Log10Kernel:   for (int i = 0; i < count; i++) values[i] = log10Value(values[i]);
+                        break;
+    case SqrtKernel:    for (int i = 0; i < count; i++) values[i] = sqrtValue(values[i]);
+                        break;
+    case AbsKernel:     for (int i = 0; i < count; i++) values[i] = absValue(values[i]);
+                        break;
+    default:            break;
+    }
+}
+
+void PhyxBatchPlan::runBinaryKernel(PhyxBatchPlan::Kernel kernel, const PhyxValueDataType *left, int leftStride, const PhyxValueDataType *right, int rightStride, PhyxValueDataType *result, int count)
+{
+    switch (kernel)
+    {
+    case AddKernel:     for (int i = 0; i < count; i++) result[i] = left[i*leftStride] + right[i*rightStride];
+                        break;
+    case SubKernel:     for (int i = 0; i < count; i++) result[i] = left[i*leftStride] - right[i*rightStride];
+                        break;
+    case MulKernel:     for (int i = 0; i < count; i++) result[i] = left[i*leftStride] * right[i*rightStride];
+                        break;
+    case DivKernel:     for (int i = 0; i < count; i++) result[i] = left[i*leftStride] / right[i*rightStride];
+                        break;
+    case PowKernel:     for (int i = 0; i < count; i++) result[i] = powValue(left[i*leftStride], right[i*rightStride]);
+                        break;
+    default:            break;
+    }
+}
+
+PhyxValueDataType PhyxBatchPlan::sinValue(const PhyxValueDataType &value)
+{
+    if (value.imag() == PHYX_FLOAT_NULL)
+        return PhyxValueDataType(std::sin(value.real()), PHYX_FLOAT_NULL);
+    else
+        return sin(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::cosValue(const PhyxValueDataType &value)
+{
+    if (value.imag() == PHYX_FLOAT_NULL)
+        return PhyxValueDataType(std::cos(value.real()), PHYX_FLOAT_NULL);
+    else
+        return cos(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::tanValue(const PhyxValueDataType &value)
+{
+    if (value.imag() == PHYX_FLOAT_NULL)
+        return PhyxValueDataType(std::tan(value.real()), PHYX_FLOAT_NULL);
+    else
+        return tan(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::sinhValue(const PhyxValueDataType &value)
+{
+    if (value.imag() == PHYX_FLOAT_NULL)
+        return PhyxValueDataType(std::sinh(value.real()), PHYX_FLOAT_NULL);
+    else
+        return sinh(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::coshValue(const PhyxValueDataType &value)
+{
+    if (value.imag() == PHYX_FLOAT_NULL)
+        return PhyxValueDataType(std::cosh(value.real()), PHYX_FLOAT_NULL);
+    else
+        return cosh(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::tanhValue(const PhyxValueDataType &value)
+{
+    if (value.imag() == PHYX_FLOAT_NULL)
+        return PhyxValueDataType(std::tanh(value.real()), PHYX_FLOAT_NULL);
+    else
+        return tanh(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::expValue(const PhyxValueDataType &value)
+{
+    if (value.imag() == PHYX_FLOAT_NULL)
+        return PhyxValueDataType(std::exp(value.real()), PHYX_FLOAT_NULL);
+    else
+        return exp(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::lnValue(const PhyxValueDataType &value)
+{
+    if ((value.imag() == PHYX_FLOAT_NULL) && (value.real() > PHYX_FLOAT_NULL))
+        return PhyxValueDataType(std::log(value.real()), PHYX_FLOAT_NULL);
+    else
+        return log(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::log10Value(const PhyxValueDataType &value)
+{
+    if ((value.imag() == PHYX_FLOAT_NULL) && (value.real() > PHYX_FLOAT_NULL))
+        return PhyxValueDataType(std::log10(value.real()), PHYX_FLOAT_NULL);
+    else
+        return log10(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::sqrtValue(const PhyxValueDataType &value)
+{
+    if ((value.imag() == PHYX_FLOAT_NULL) && (value.real() >= PHYX_FLOAT_NULL))
+        return PhyxValueDataType(std::sqrt(value.real()), PHYX_FLOAT_NULL);
+    else
+        return sqrt(value);
+}
+
+PhyxValueDataType PhyxBatchPlan::absValue(const PhyxValueDataType &value)
+{
+    if (value.imag() == PHYX_FLOAT_NULL)
+        return PhyxValueDataType(std::fabs(value.real()), PHYX_FLOAT_NULL);
+    else
+        return PhyxValueDataType(abs(value), PHYX_FLOAT_NULL);
+}
+
+PhyxValueDataType PhyxBatchPlan::powValue(const PhyxValueDataType &base, const PhyxValueDataType &exponent)
+{
+    if ((base.imag() == PHYX_FLOAT_NULL) && (exponent.imag() == PHYX_FLOAT_NULL)
+            && ((base.real() >= PHYX_FLOAT_NULL) || (std::floor(exponent.real()) == exponent.real())))
+        return PhyxValueDataType(std::pow(base.real(), exponent.real()), PHYX_FLOAT_NULL);
+    else if (exponent.imag() == PHYX_FLOAT_NULL)     // precision fix
+        return pow(base, exponent.real());
+    else
+        return pow(base, exponent);
+}
+
+PhyxBatchChunk::PhyxBatchChunk(const PhyxBatchPlan *plan,
+                               const PhyxValueDataType *parameters,
+                               PhyxValueDataType *result,
+                               int count,
+                               QAtomicInt *finishedCount,
+                               QAtomicInt *canceled,
+                               QAtomicInt *failed)
+{
+    m_plan = plan;
+    m_parameters = parameters;
+    m_result = result;
+    m_count = count;
+    m_finishedCount = finishedCount;
+    m_canceled = canceled;
+    m_failed = failed;
+}
+
+void PhyxBatchChunk::run()
+{
+    if (m_canceled->fetchAndAddOrdered(0) == 0)
+    {
+        if (!m_plan->run(m_parameters, m_result, m_count))
+            m_failed->fetchAndStoreOrdered(1);
+    }
+
+    m_finishedCount->fetchAndAddOrdered(m_count);
+}
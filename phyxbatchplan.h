@@ -0,0 +1,130 @@
+/**************************************************************************
+**
+** This file is part of PhyxCalc.
+**
+** PhyxCalc is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** PhyxCalc is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with PhyxCalc.  If not, see <http://www.gnu.org/licenses/>.
+**
+***************************************************************************/
+
+#ifndef PHYXBATCHPLAN_H
+#define PHYXBATCHPLAN_H
+
+#include <QVector>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <complex>
+#include "global.h"
+
+typedef std::complex<PhyxFloatDataType>   PhyxValueDataType;      /// the base data type for values
+typedef QVector<PhyxValueDataType>        PhyxValueColumn;        /// the values of one operand for all samples of a batch
+
+/// the value operations of a function of one parameter, the units are resolved when the plan is built
+/// a plan does not touch the calculator, so it can run for several chunks of samples in parallel
+class PhyxBatchPlan
+{
+public:
+    enum Kernel {
+        NoKernel,
+        NegKernel,
+        SinKernel,
+        CosKernel,
+        TanKernel,
+        SinhKernel,
+        CoshKernel,
+        TanhKernel,
+        ExpKernel,
+        LnKernel,
+        Log10Kernel,
+        SqrtKernel,
+        AbsKernel,
+        AddKernel,
+        SubKernel,
+        MulKernel,
+        DivKernel,
+        PowKernel
+    };
+
+    enum StepType {
+        ParameterStep,          /// loads the samples of the parameter into a column
+        ScaleStep,              /// scales and offsets a column after a unit change
+        UnaryStep,              /// runs a kernel on a column
+        BinaryStep,             /// runs a kernel on a column and the next one and stores the result in the first
+        CheckComplexStep        /// fails if a sample of a column is complex
+    };
+
+    typedef struct {
+        StepType type;
+        Kernel  kernel;
+        int     column;                 /// column the step works on
+        int     uniformOperand;         /// operand of a binary step that has the same value for all samples, -1 if none
+        PhyxValueDataType value;        /// value of the uniform operand, for scale steps the offset as real and the scale as imaginary part
+    } Step;
+
+    PhyxBatchPlan();
+
+    void clear();
+    void appendStep(StepType type, int column, Kernel kernel = NoKernel, int uniformOperand = -1, PhyxValueDataType value = PhyxValueDataType());
+    void setUniformResult(PhyxValueDataType value);                         ///< the result has the same value for all samples
+    bool run(const PhyxValueDataType *parameters, PhyxValueDataType *result, int count) const;     ///< runs the plan for count samples, returns false if a sample is complex where a real value is required
+
+    // the functions of the kernels, shared with the calculator so a batch gives the same values as a single evaluation
+    // real arguments inside the real domain of a function use the real function, all others the complex one
+    static PhyxValueDataType sinValue(const PhyxValueDataType &value);
+    static PhyxValueDataType cosValue(const PhyxValueDataType &value);
+    static PhyxValueDataType tanValue(const PhyxValueDataType &value);
+    static PhyxValueDataType sinhValue(const PhyxValueDataType &value);
+    static PhyxValueDataType coshValue(const PhyxValueDataType &value);
+    static PhyxValueDataType tanhValue(const PhyxValueDataType &value);
+    static PhyxValueDataType expValue(const PhyxValueDataType &value);
+    static PhyxValueDataType lnValue(const PhyxValueDataType &value);                                          ///< real for positive real values
+    static PhyxValueDataType log10Value(const PhyxValueDataType &value);                                       ///< real for positive real values
+    static PhyxValueDataType sqrtValue(const PhyxValueDataType &value);                                        ///< real for non negative real values
+    static PhyxValueDataType absValue(const PhyxValueDataType &value);
+    static PhyxValueDataType powValue(const PhyxValueDataType &base, const PhyxValueDataType &exponent);      ///< real for a real base that is non negative or has a whole exponent
+
+    static void runUnaryKernel(Kernel kernel, PhyxValueDataType *values, int count);  ///< applies a kernel to every sample
+    static void runBinaryKernel(Kernel kernel, const PhyxValueDataType *left, int leftStride, const PhyxValueDataType *right, int rightStride, PhyxValueDataType *result, int count);    ///< applies a kernel to every pair of samples, a stride of 0 repeats a single value
+
+private:
+    QVector<Step>       m_steps;
+    int                 m_columnCount;
+    bool                m_uniformResult;
+    PhyxValueDataType   m_resultValue;
+};
+
+/// runs a plan for one chunk of samples in a worker thread
+class PhyxBatchChunk : public QRunnable
+{
+public:
+    PhyxBatchChunk(const PhyxBatchPlan *plan,
+                   const PhyxValueDataType *parameters,
+                   PhyxValueDataType *result,
+                   int count,
+                   QAtomicInt *finishedCount,
+                   QAtomicInt *canceled,
+                   QAtomicInt *failed);
+
+    void run();
+
+private:
+    const PhyxBatchPlan     *m_plan;
+    const PhyxValueDataType *m_parameters;
+    PhyxValueDataType       *m_result;
+    int                     m_count;
+    QAtomicInt              *m_finishedCount;   /// number of finished samples of all chunks
+    QAtomicInt              *m_canceled;        /// set if the remaining chunks should be skipped
+    QAtomicInt              *m_failed;          /// set if a chunk failed
+};
+
+#endif // PHYXBATCHPLAN_H
@@ -25,7 +25,14 @@ PhyxCalculator::PhyxCalculator(QObject *parent) :
     initialize();
 }
 
-void PhyxCalculator::initialize()
+PhyxCalculator::PhyxCalculator(QSharedPointer<PhyxCalculator> base, QObject *parent) :
+    QObject(parent)
+{
+    m_base = base;
+    initialize(base.data());
+}
+
+void PhyxCalculator::initialize(const PhyxCalculator *base)
 {
     //initialize variables
     m_expression = "";
@@ -35,7 +42,11 @@ void PhyxCalculator::initialize()
     unitBuffer = "";
     flagBuffer = 0;
     stackLevel = 0;
+    frameBase = 0;
+    variableAllocations = 0;
+    datasetRunning = false;
     listModeActive = false;
+    listResult = NULL;
     noGuiUpdate = false;
     m_error = false;
     m_errorNumber = 0;
@@ -54,6 +65,9 @@ void PhyxCalculator::initialize()
 
     // create earley parser
     earleyParser = new QEarleyParser(this);
+    functionParser = new QEarleyParser(this);
+
+    datasetThreadPool = new QThreadPool(this);
 
     //map functions
     functionMap.insert("valueCheckComplex",     &PhyxCalculator::valueCheckComplex);
@@ -258,8 +272,40 @@ void PhyxCalculator::initialize()
     functionMap.insert("datasetLogCreate",      &PhyxCalculator::datasetLogCreate);
     functionMap.insert("datasetLogCreateStep",  &PhyxCalculator::datasetLogCreateStep);
 
-    loadGrammar(":/settings/grammar");
-    earleyParser->setStartSymbol("S");
+    //resolve function names to action codes once, evaluation only indexes actionTable
+    actionNames.append("bufferParameter");
+    actionTable.append(NULL);
+    actionNames.append("parameterLoad");    //only set by compileFunction, not used by the grammar
+    actionTable.append(NULL);
+    QHashIterator<QString, void (PhyxCalculator::*)()> functionIterator(functionMap);
+    while (functionIterator.hasNext())
+    {
+        functionIterator.next();
+        actionNames.append(functionIterator.key());
+        actionTable.append(functionIterator.value());
+    }
+    initializeBatchActions();
+
+    if (base == NULL)
+    {
+        earleyParser->setActions(actionNames);
+        loadGrammar(":/settings/grammar");
+        earleyParser->setStartSymbol("S");
+
+        //user definitions are matched by lexicons instead of one rule per definition
+        addLexiconRule("unit", "bufferParameter, bufferUnit");
+        addLexiconRule("variable", "bufferParameter, variableLoad");
+        addLexiconRule("constant", "bufferParameter, constantLoad");
+        addLexiconRule("prefix", "bufferParameter, bufferPrefix");
+        addLexiconRule("unitGroup", "bufferParameter, bufferUnitGroup");
+    }
+    else
+    {
+        earleyParser->shareRules(base->earleyParser);
+        phyxRules = base->phyxRules;
+        if (actionNames != base->actionNames)   //the action codes of the shared rules would not match
+            earleyParser->setActions(actionNames);
+    }
 
     standardFunctionList.append("sin");
     standardFunctionList.append("arcsin");
@@ -374,6 +420,16 @@ void PhyxCalculator::initialize()
     connect(variableManager, SIGNAL(functionRemoved(QString,int)),
             this, SLOT(removeFunctionRule(QString,int)));
 
+    //the definitions of base are already in the shared grammar, so no signals are needed
+    if (base != NULL)
+    {
+        unitSystem->share(base->unitSystem);
+        variableManager->share(base->variableManager);
+    }
+
+    //template for resetting pooled stack variables
+    noUnit = new PhyxCompoundUnit(this);
+
     //initialize special variable #
     PhyxVariable *variable = new PhyxVariable(this);
     variable->setValue(PhyxValueDataType(PHYX_FLOAT_NULL,PHYX_FLOAT_NULL));
@@ -522,116 +578,156 @@ void PhyxCalculator::addRule(QString rule, QString functions)
     earleyParser->loadRule(rule, ruleFunctions);
 }
 
+void PhyxCalculator::addRule(QString premise, QVector<EarleySymbol> conclusion, QString functions)
+{
+    QStringList ruleFunctions;
+    foreach (QString function, functions.split(',', QString::SkipEmptyParts))
+        ruleFunctions.append(function.trimmed());
+    earleyParser->loadRule(earleyParser->nonTerminalSymbol(premise), conclusion, ruleFunctions);
+}
+
+void PhyxCalculator::removeRule(QString premise, QVector<EarleySymbol> conclusion)
+{
+    earleyParser->removeRule(earleyParser->nonTerminalSymbol(premise), conclusion);
+}
+
+void PhyxCalculator::addLexiconRule(QString premise, QString functions)
+{
+    QVector<EarleySymbol> conclusion;
+    conclusion.append(earleyParser->addLexicon(premise));
+    addRule(premise, conclusion, functions);
+}
+
+void PhyxCalculator::addLexiconWord(QString lexicon, QString word)
+{
+    earleyParser->addLexiconWord(earleyParser->lexiconSymbol(lexicon), word);
+}
+
+void PhyxCalculator::removeLexiconWord(QString lexicon, QString word)
+{
+    earleyParser->removeLexiconWord(earleyParser->lexiconSymbol(lexicon), word);
+}
+
+QVector<EarleySymbol> PhyxCalculator::literalSymbols(QString string)
+{
+    QVector<EarleySymbol> symbols;
+    symbols.reserve(string.size());
+    foreach (QChar character, string)
+        symbols.append(character.unicode());
+    return symbols;
+}
+
+QVector<EarleySymbol> PhyxCalculator::functionRuleSymbols(QString name, int parameterCount) const
+{
+    QVector<EarleySymbol> symbols = literalSymbols(name);
+    if (parameterCount == 1)
+    {
+        symbols.append(earleyParser->nonTerminalSymbol("funcParam"));
+    }
+    else if (parameterCount > 1)
+    {
+        symbols.append('(');
+        for (int i = 0; i < parameterCount; i++)
+        {
+            if (i > 0)
+                symbols.append(',');
+            symbols.append(earleyParser->nonTerminalSymbol("p3"));
+        }
+        symbols.append(')');
+    }
+    return symbols;
+}
+
 void PhyxCalculator::addUnitRule(QString symbol)
 {
-    addRule(QString("unit=%1").arg(symbol), QString("bufferParameter, bufferUnit"));
+    recordWrite("unit:" + symbol);
+    addLexiconWord("unit", symbol);
     if (!noGuiUpdate)
         emit unitsChanged();
 }
 
 void PhyxCalculator::removeUnitRule(QString symbol)
 {
-    earleyParser->removeRule(QString("unit=%1").arg(symbol));
+    recordWrite("unit:" + symbol);
+    removeLexiconWord("unit", symbol);
     if (!noGuiUpdate)
         emit unitsChanged();
 }
 
 void PhyxCalculator::addVariableRule(QString name)
 {
-    addRule(QString("variable=%1").arg(name), QString("bufferParameter, variableLoad"));
+    recordWrite("variable:" + name);
+    addLexiconWord("variable", name);
     if (!noGuiUpdate)
         emit variablesChanged();
 }
 
 void PhyxCalculator::removeVariableRule(QString name)
 {
-    earleyParser->removeRule(QString("variable=%1").arg(name));
+    recordWrite("variable:" + name);
+    removeLexiconWord("variable", name);
     if (!noGuiUpdate)
         emit variablesChanged();
 }
 
 void PhyxCalculator::addConstantRule(QString name)
 {
-    addRule(QString("constant=%1").arg(name), QString("bufferParameter, constantLoad"));
+    recordWrite("constant:" + name);
+    addLexiconWord("constant", name);
     if (!noGuiUpdate)
         emit constantsChanged();
 }
 
 void PhyxCalculator::removeConstantRule(QString name)
 {
-    earleyParser->removeRule(QString("constant=%1").arg(name));
+    recordWrite("constant:" + name);
+    removeLexiconWord("constant", name);
     if (!noGuiUpdate)
         emit constantsChanged();
 }
 
 void PhyxCalculator::addPrefixRule(QString symbol)
 {
-    addRule(QString("prefix=%1").arg(symbol), QString("bufferParameter, bufferPrefix"));
+    recordWrite("prefix:" + symbol);
+    addLexiconWord("prefix", symbol);
     if (!noGuiUpdate)
         emit prefixesChanged();
 }
 
 void PhyxCalculator::removePrefixRule(QString symbol)
 {
-    earleyParser->removeRule(QString("prefix=%1").arg(symbol));
+    recordWrite("prefix:" + symbol);
+    removeLexiconWord("prefix", symbol);
     if (!noGuiUpdate)
         emit prefixesChanged();
 }
 
 void PhyxCalculator::addUnitGroupRule(QString name)
 {
-    addRule(QString("unitGroup=%1").arg(name), QString("bufferParameter, bufferUnitGroup"));
+    recordWrite("unitGroup:" + name);
+    addLexiconWord("unitGroup", name);
 }
 
 void PhyxCalculator::removeUnitGroupRule(QString name)
 {
-    earleyParser->removeRule(QString("unitGroup=%1").arg(name));
+    recordWrite("unitGroup:" + name);
+    removeLexiconWord("unitGroup", name);
 }
 
 void PhyxCalculator::addFunctionRule(QString name, int parameterCount)
 {
-    QString ruleString;
-    ruleString.append(QString("custom_function=%1").arg(name));
-    if (parameterCount == 1)
-    {
-        ruleString.append("|funcParam|");
-    }
-    else if (parameterCount > 1)
-    {
-        ruleString.append("(");
-        for (int i = 0; i < parameterCount; i++)
-        {
-            if (i > 0)
-                ruleString.append(",");
-            ruleString.append("|p3|");
-        }
-        ruleString.append(")");
-    }
-    addRule(ruleString, QString("bufferParameter, functionRun"));
+    recordWrite("function:" + name);
+    compiledFunctions.remove(name);
+    addRule("custom_function", functionRuleSymbols(name, parameterCount), "bufferParameter, functionRun");
     if (!noGuiUpdate)
         emit functionsChanged();
 }
 
 void PhyxCalculator::removeFunctionRule(QString name, int parameterCount)
 {
-    QString ruleString;
-    ruleString.append(QString("custom_function=%1").arg(name));
-    if (parameterCount == 1)
-    {
-        ruleString.append("|funcParam|");
-    }
-    else if (parameterCount > 1)
-    {
-        ruleString.append("(");
-        for (int i = 0; i < parameterCount; i++)
-        {
-            if (i > 0)
-                ruleString.append(",");
-            ruleString.append("|p3|");
-        }
-        ruleString.append(")");
-    }
-    earleyParser->removeRule(ruleString);
+    recordWrite("function:" + name);
+    compiledFunctions.remove(name);
+    removeRule("custom_function", functionRuleSymbols(name, parameterCount));
     if (!noGuiUpdate)
         emit functionsChanged();
 }
@@ -639,13 +735,7 @@ void PhyxCalculator::removeFunctionRule(QString name, int parameterCount)
 void PhyxCalculator::clearStack()
 {
     foreach (PhyxVariable *variable, variableStack)
-    {
-        if (variable)
-        {
-            variable->deleteLater();
-            variable = NULL;
-        }
-    }
+        releaseVariable(variable);
     variableStack.clear();
     lowLevelStack.clear();
     functionParameterStack.clear();
@@ -664,6 +754,9 @@ void PhyxCalculator::clearFlags()
 
 bool PhyxCalculator::setExpression(QString expression)
 {
+    if (datasetRunning)     //events processed while a dataset is calculated must not change the state it uses
+        return false;
+
     expression = stripComments(expression);
     expression = removeWhitespace(expression, &expressionWhitespaceList);
 
@@ -680,25 +773,9 @@ bool PhyxCalculator::setExpression(QString expression)
             stackLevel = 0;
         }
     }
-    else if (!m_expression.isEmpty() && expression.indexOf(m_expression) == 0)      //new expression is old expression + string
-    {
-        QString string = expression.mid(m_expression.size());
-        foreach (QChar character, string)
-        {
-            expressionIsParsable = earleyParser->addSymbol(character);
-        }
-    }
-    else if (m_expression.indexOf(expression) == 0) //new expression is old expression - string
-    {
-        int  count = m_expression.size() - expression.size();
-        for (int i = 0; i < count; i++)
-        {
-            expressionIsParsable = earleyParser->removeSymbol();
-        }
-    }
     else
     {
-        expressionIsParsable = earleyParser->parseWord(expression);
+        expressionIsParsable = earleyParser->updateWord(expression);    //only the part behind the first changed character is parsed again
     }
 
     m_expression = expression;
@@ -707,6 +784,12 @@ bool PhyxCalculator::setExpression(QString expression)
 
 bool PhyxCalculator::evaluate()
 {
+    if (datasetRunning)
+        return false;
+
+    m_readSymbols.clear();
+    m_writtenSymbols.clear();
+
     if (expressionIsParsable)
     {
         clearResult();
@@ -737,7 +820,8 @@ bool PhyxCalculator::evaluate(QList<EarleyTreeItem> earleyTree, const QString ex
         //if (!phyxRule.functions.isEmpty())
         //if (!earleyTreeItem->rule->functions.isEmpty())
         //{
-            foreach (QString function, earleyTreeItem->rule->functions)
+            const QVector<int> &actions = earleyTreeItem->rule->actions;
+            for (int j = 0; j < actions.size(); j++)
             {
                 if (this->hasError())
                 {
@@ -748,19 +832,18 @@ bool PhyxCalculator::evaluate(QList<EarleyTreeItem> earleyTree, const QString ex
                     return false;
                 }
 
-                if (function == "bufferParameter")
+                int action = actions.at(j);
+                if (action == PHYX_ACTION_BUFFER_PARAMETER)
                     parameterBuffer = expression.mid(earleyTreeItem->startPos, earleyTreeItem->endPos - earleyTreeItem->startPos + 1);
                 else
                 {
 #ifdef QT_DEBUG
-                    qDebug() << function;
-                    if (functionMap.value(function, NULL) != NULL)
-#endif
-                        (this->*functionMap.value(function))();
-#ifdef QT_DEBUG
+                    if (action != -1)
+                        qDebug() << actionNames.at(action);
                     else
-                        qFatal("Function %s not found!", function.toLatin1().constData());
+                        qFatal("Function %s not found!", earleyTreeItem->rule->functions.at(j).toLatin1().constData());
 #endif
+                    (this->*actionTable.at(action))();
                 }
             }
         //}
@@ -793,22 +876,21 @@ bool PhyxCalculator::evaluate(PhyxCalculator::ExpressionCacheItem cacheItem, con
             return false;
         }
 
-        QString function = cacheItem.function(i);
+        int action = cacheItem.action(i);
 
-        if (function == "bufferParameter")
+        if (action == PHYX_ACTION_BUFFER_PARAMETER)
             parameterBuffer = cacheItem.parameter(i);
+        else if (action == PHYX_ACTION_PARAMETER_LOAD)
+            pushVariableCopy(frameVariables.at(frameBase + cacheItem.slotList.at(i)));
         else
         {
 #ifdef QT_DEBUG
-            qDebug() << function;
-
-        if (functionMap.value(function, NULL) != NULL)
-#endif
-            (this->*functionMap.value(function))();
-#ifdef QT_DEBUG
-        else
-             qFatal("Function %s not found!", function.toLatin1().constData());
+            if (action != -1)
+                qDebug() << actionNames.at(action);
+            else
+                qFatal("Function not found!");
 #endif
+            (this->*actionTable.at(action))();
         }
     }
     stackLevel--;
@@ -820,6 +902,9 @@ bool PhyxCalculator::evaluate(PhyxCalculator::ExpressionCacheItem cacheItem, con
 
 void PhyxCalculator::loadFile(QString fileName)
 {
+    if (datasetRunning)
+        return;
+
     QFile file(fileName);
 
     if (file.open(QIODevice::ReadOnly | QIODevice::Text))
@@ -840,14 +925,123 @@ void PhyxCalculator::loadFile(QString fileName)
     }
 }
 
+bool PhyxCalculator::loadSnapshot(QString fileName, QStringList sourceFiles)
+{
+    if (datasetRunning)
+        return false;
+
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    // map the file instead of reading it into a buffer, fall back to reading if mapping is not supported
+    // the stream still copies every string, rule and unit into the containers of the loaded state
+    QByteArray data;
+    uchar *mappedData = file.map(0, file.size());
+    if (mappedData != NULL)
+        data = QByteArray::fromRawData(reinterpret_cast<const char*>(mappedData), file.size());
+    else
+        data = file.readAll();
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_4_6);
+
+    quint32 magic;
+    quint32 version;
+    quint32 floatSize;
+    QByteArray hash;
+    stream >> magic >> version >> floatSize >> hash;
+
+    if ((stream.status() != QDataStream::Ok)
+            || (magic != PHYX_SNAPSHOT_MAGIC)
+            || (version != PHYX_SNAPSHOT_VERSION)
+            || (floatSize != sizeof(PhyxFloatDataType))
+            || (hash != snapshotHash(sourceFiles)))
+        return false;
+
+    // every part is read into temporaries, the calculator is only changed when the whole snapshot is valid
+    QEarleyParser loadedParser;
+    PhyxUnitSystem loadedUnitSystem;
+    PhyxVariableManager loadedVariableManager;
+    loadedParser.shareRules(earleyParser);      // the action codes are not stored in the snapshot
+
+    if (!loadedParser.loadRules(stream) || !loadedUnitSystem.load(stream))
+    {
+        qWarning() << "Snapshot corrupted:" << fileName;
+        return false;
+    }
+
+    // the units of the variables have to point to the system they belong to, so the loaded units are swapped in while the variables are read
+    unitSystem->swap(&loadedUnitSystem);
+    if (!loadedVariableManager.load(stream, unitSystem))
+    {
+        unitSystem->swap(&loadedUnitSystem);
+        qWarning() << "Snapshot corrupted:" << fileName;
+        return false;
+    }
+
+    earleyParser->shareRules(&loadedParser);
+    variableManager->swap(&loadedVariableManager);    // the old content is deleted with the temporaries
+
+    m_expression.clear();
+    expressionIsParsable = false;
+
+    return true;
+}
+
+bool PhyxCalculator::saveSnapshot(QString fileName, QStringList sourceFiles)
+{
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+
+    stream << static_cast<quint32>(PHYX_SNAPSHOT_MAGIC)
+           << static_cast<quint32>(PHYX_SNAPSHOT_VERSION)
+           << static_cast<quint32>(sizeof(PhyxFloatDataType))
+           << snapshotHash(sourceFiles);
+
+    earleyParser->saveRules(stream);
+    unitSystem->save(stream);
+    variableManager->save(stream);
+
+    return (stream.status() == QDataStream::Ok);
+}
+
+QByteArray PhyxCalculator::snapshotHash(QStringList sourceFiles)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    hash.addData(QByteArray(VERSION_MAJOR));
+    foreach (QString fileName, sourceFiles)
+    {
+        QFile file(fileName);
+        hash.addData(fileName.toUtf8());
+        if (file.open(QIODevice::ReadOnly))
+            hash.addData(file.readAll());
+    }
+
+    return hash.result();
+}
+
 PhyxVariable *PhyxCalculator::variable(QString name) const
 {
-    return variableManager->getVariable(name);
+    PhyxVariable *variable = variableManager->getVariable(name);
+    if (variable != NULL)
+        variable->unit()->setUnitSystem(unitSystem);
+    return variable;
 }
 
 PhyxVariable *PhyxCalculator::constant(QString name) const
 {
-    return variableManager->getConstant(name);
+    PhyxVariable *variable = variableManager->getConstant(name);
+    if (variable != NULL)
+        variable->unit()->setUnitSystem(unitSystem);
+    return variable;
 }
 
 PhyxUnit *PhyxCalculator::unit(QString symbol) const
@@ -872,9 +1066,28 @@ PhyxVariableManager::PhyxDataset *PhyxCalculator::dataset(int index) const
 
 void PhyxCalculator::clearVariables()
 {
+    if (datasetRunning)
+        return;
+
     variableManager->clearVariables();
 }
 
+void PhyxCalculator::cancelDataset()
+{
+    datasetCanceled.fetchAndStoreOrdered(1);
+}
+
+void PhyxCalculator::recordRead(QString symbol)
+{
+    m_readSymbols.insert(symbol);
+}
+
+void PhyxCalculator::recordWrite(QString symbol)
+{
+    if (!noGuiUpdate)   //temporary changes, like the parameters of functions, are not visible to the document
+        m_writtenSymbols.insert(symbol);
+}
+
 PhyxVariableManager::PhyxVariableMap *PhyxCalculator::variables() const
 {
     return variableManager->variables();
@@ -923,7 +1136,6 @@ QString PhyxCalculator::complexToString(const PhyxValueDataType number,
                                         bool useFractions)
 {
     QString string;
-    boost::format format(QString("%.%1%2").arg(precision).arg(numberFormat).toStdString());
     int components = 0;
     //bool useInteger = false;
 
@@ -936,26 +1148,21 @@ QString PhyxCalculator::complexToString(const PhyxValueDataType number,
 
     if (number.real() != PHYX_FLOAT_NULL)
     {
-        std::ostringstream ss;
         if (!useFractions)
         {
             //if (!useInteger)
-            ss << format % number.real();
+            string.append(floatToString(number.real(), precision, numberFormat));
     //      else
     //            ss << format % static_cast<PhyxIntegerDataType>(number.real());
-            string.append(QString::fromStdString(ss.str()));
         }
         else
         {
             PhyxFraction fraction = decimalToFraction(number.real(),precision);
-            ss << format % fraction.numerator;
-            string.append(QString::fromStdString(ss.str()));
+            string.append(floatToString(fraction.numerator, precision, numberFormat));
             if (fraction.denominator != PHYX_FLOAT_ONE)
             {
                 string.append("/");
-                ss.str("");
-                ss << format % fraction.denominator;
-                string.append(QString::fromStdString(ss.str()));
+                string.append(floatToString(fraction.denominator, precision, numberFormat));
             }
         }
         components++;
@@ -967,23 +1174,18 @@ QString PhyxCalculator::complexToString(const PhyxValueDataType number,
             string.append("+");
         if ((number.imag() != 1) && (number.imag() != -1))
         {
-            std::ostringstream ss;
             if (!useFractions)
             {
-                ss << format % number.imag();
-                string.append(QString::fromStdString(ss.str()));
+                string.append(floatToString(number.imag(), precision, numberFormat));
             }
             else
             {
                 PhyxFraction fraction = decimalToFraction(number.imag(),precision);
-                ss << format % fraction.numerator;
-                string.append(QString::fromStdString(ss.str()));
+                string.append(floatToString(fraction.numerator, precision, numberFormat));
                 if (fraction.denominator != PHYX_FLOAT_ONE)
                 {
                     string.append("/");
-                    ss.str("");
-                    ss << format % fraction.denominator;
-                    string.append(QString::fromStdString(ss.str()));
+                    string.append(floatToString(fraction.denominator, precision, numberFormat));
                 }
             }
         }
@@ -1010,27 +1212,161 @@ QString PhyxCalculator::complexToString(const PhyxValueDataType number,
 
 PhyxValueDataType PhyxCalculator::stringToComplex(QString string)
 {
-    PhyxValueDataType value;
+    //the grammar only allows the imaginary unit in front of or behind the number
+    const QChar *data = string.constData();
+    int length = string.size();
+    bool imaginary = false;
 
-    if (string.indexOf(QRegExp("[ij]")) != -1)
+    if ((length > 0) && ((data[length-1] == QChar('i')) || (data[length-1] == QChar('j'))))
+    {
+        imaginary = true;
+        length--;
+    }
+    else if ((length > 0) && ((data[0] == QChar('i')) || (data[0] == QChar('j'))))
     {
-        string.remove(QRegExp("[ij]"));
-        if (string.isEmpty())
-            string="1";
+        imaginary = true;
+        data++;
+        length--;
+    }
 
-        PhyxFloatDataType tmpValue;
-        std::istringstream inStream(string.toStdString());
-        inStream >> tmpValue;
-        value = PhyxValueDataType(PHYX_FLOAT_NULL,tmpValue);
+    if (imaginary)
+    {
+        if (length == 0)
+            return PhyxValueDataType(PHYX_FLOAT_NULL, PHYX_FLOAT_ONE);
+        return PhyxValueDataType(PHYX_FLOAT_NULL, stringToFloat(data, length));
     }
+    else
+        return PhyxValueDataType(stringToFloat(data, length), PHYX_FLOAT_NULL);
+}
+
+QString PhyxCalculator::floatToString(PhyxFloatDataType number, int precision, char numberFormat)
+{
+    char format[] = "%.*" PHYX_FLOAT_PRINTF_LENGTH "g";
+    if ((numberFormat == 'f') || (numberFormat == 'e') || (numberFormat == 'E') || (numberFormat == 'G'))
+        format[sizeof(format)-2] = numberFormat;
+
+    char buffer[64];
+    int length = snprintf(buffer, sizeof(buffer), format, precision, number);
+    if (length < 0)
+        return QString();
+
+    QString string;
+    if (length < static_cast<int>(sizeof(buffer)))
+        string = QString::fromLatin1(buffer, length);
     else
     {
-        PhyxFloatDataType tmpValue;
-        std::istringstream inStream(string.toStdString());
-        inStream >> tmpValue;
-        value = PhyxValueDataType(tmpValue,PHYX_FLOAT_NULL);
+        //huge numbers in 'f' format do not fit the buffer on the stack
+        QByteArray largeBuffer(length+1, '\0');
+        snprintf(largeBuffer.data(), largeBuffer.size(), format, precision, number);
+        string = QString::fromLatin1(largeBuffer.constData(), length);
     }
 
+    //the application sets the C locale to the system locale, which may use a decimal comma
+    const char decimalPoint = localeconv()->decimal_point[0];
+    if (decimalPoint != '.')
+        string.replace(QLatin1Char(decimalPoint), QLatin1Char('.'));
+
+    return string;
+}
+
+PhyxFloatDataType PhyxCalculator::stringToFloat(const QChar *data, int length)
+{
+    //powers of ten that are exactly representable, a mantissa that fits the floating point type
+    //multiplied or divided by one of them is a single correctly rounded operation
+    static const PhyxFloatDataType exactPowers[] = {1e0L,  1e1L,  1e2L,  1e3L,  1e4L,  1e5L,  1e6L,
+                                                    1e7L,  1e8L,  1e9L,  1e10L, 1e11L, 1e12L, 1e13L,
+                                                    1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L,
+                                                    1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L};
+    static const int mantissaBits = std::numeric_limits<PhyxFloatDataType>::digits;
+    static const int maxExactPower = (mantissaBits >= 64) ? 27 : 22;
+    static const quint64 maxExactMantissa = (mantissaBits >= 64) ? Q_UINT64_C(0xFFFFFFFFFFFFFFFF)
+                                                                 : (Q_UINT64_C(1) << (mantissaBits & 63));
+
+    quint64 mantissa = 0;
+    int mantissaDigits = 0;
+    int exponent = 0;
+    bool exact = true;
+    int digitCount = 0;
+    int i = 0;
+
+    for (; (i < length) && (data[i] >= QChar('0')) && (data[i] <= QChar('9')); i++)
+    {
+        int digit = data[i].unicode() - '0';
+        digitCount++;
+        if (mantissaDigits < 19)
+        {
+            mantissa = mantissa * 10 + digit;
+            if (mantissa != 0)
+                mantissaDigits++;
+        }
+        else
+        {
+            exponent++;
+            if (digit != 0)
+                exact = false;
+        }
+    }
+
+    if ((i < length) && (data[i] == QChar('.')))
+    {
+        for (i++; (i < length) && (data[i] >= QChar('0')) && (data[i] <= QChar('9')); i++)
+        {
+            int digit = data[i].unicode() - '0';
+            digitCount++;
+            if (mantissaDigits < 19)
+            {
+                mantissa = mantissa * 10 + digit;
+                exponent--;
+                if (mantissa != 0)
+                    mantissaDigits++;
+            }
+            else if (digit != 0)
+                exact = false;
+        }
+    }
+
+    if ((i < length) && ((data[i] == QChar('e')) || (data[i] == QChar('E'))))
+    {
+        bool negative = false;
+        int exponentDigits = 0;
+        int literalExponent = 0;
+
+        i++;
+        if ((i < length) && ((data[i] == QChar('+')) || (data[i] == QChar('-'))))
+        {
+            negative = (data[i] == QChar('-'));
+            i++;
+        }
+        for (; (i < length) && (data[i] >= QChar('0')) && (data[i] <= QChar('9')); i++)
+        {
+            if (literalExponent < 100000)
+                literalExponent = literalExponent * 10 + (data[i].unicode() - '0');
+            exponentDigits++;
+        }
+        if (exponentDigits == 0)
+            exact = false;
+
+        exponent += negative ? -literalExponent : literalExponent;
+    }
+
+    if (exact && (digitCount > 0) && (i == length))
+    {
+        if (mantissa == 0)
+            return PHYX_FLOAT_NULL;
+        if ((mantissa <= maxExactMantissa) && (exponent >= -maxExactPower) && (exponent <= maxExactPower))
+        {
+            if (exponent >= 0)
+                return static_cast<PhyxFloatDataType>(mantissa) * exactPowers[exponent];
+            else
+                return static_cast<PhyxFloatDataType>(mantissa) / exactPowers[-exponent];
+        }
+    }
+
+    //everything else goes through the exact but slow stream conversion
+    PhyxFloatDataType value = PHYX_FLOAT_NULL;
+    std::istringstream inStream(QString(data, length).toStdString());
+    inStream.imbue(std::locale::classic());
+    inStream >> value;
     return value;
 }
 
@@ -1067,7 +1403,7 @@ PhyxIntegerDataType PhyxCalculator::octToLongInt(QString string)
     return value;
 }
 
-long PhyxCalculator::binToLongInt(QString string)
+PhyxIntegerDataType PhyxCalculator::binToLongInt(QString string)
 {
     PhyxIntegerDataType value = 0;
     PhyxIntegerDataType n = 1;
@@ -1190,7 +1526,7 @@ PhyxIntegerDataType PhyxCalculator::gcd(PhyxIntegerDataType x, PhyxIntegerDataTy
 
 PhyxIntegerDataType PhyxCalculator::lcm(PhyxIntegerDataType x, PhyxIntegerDataType y)
 {
-    return (abs(x)/gcd(x,y))*abs(y);
+    return (qAbs(x)/gcd(x,y))*qAbs(y);
 }
 
 PhyxFloatDataType PhyxCalculator::toInt(PhyxFloatDataType x)
@@ -1354,9 +1690,9 @@ const PhyxCalculator::ExpressionCacheItem PhyxCalculator::earleyTreeToCacheItem(
     ExpressionCacheItem cacheItem;
     for (int i = (earleyTree.size()-1); i >= 0; i--)
     {
-        for (int ii = 0; ii < earleyTree.at(i).rule->functions.size(); ii++)
+        for (int ii = 0; ii < earleyTree.at(i).rule->actions.size(); ii++)
         {
-            cacheItem.appendItem(earleyTree.at(i).rule->functions.at(ii), earleyTree.at(i).startPos, earleyTree.at(i).endPos);
+            cacheItem.appendItem(earleyTree.at(i).rule->actions.at(ii), earleyTree.at(i).startPos, earleyTree.at(i).endPos);
         }
     }
     cacheItem.expression = expression;
@@ -1386,14 +1722,70 @@ void PhyxCalculator::pushVariables(int count, int deleteCount)
     }
     for (int i = count; i < (count + deleteCount); i++)
     {
-        if (variableList[i] != NULL)
-        {
-            variableList[i]->deleteLater();
-            variableList[i] = NULL;
-        }
+        releaseVariable(variableList[i]);
+        variableList[i] = NULL;
     }
 }
 
+PhyxVariable *PhyxCalculator::newVariable()
+{
+    if (variablePool.isEmpty())
+    {
+        variableAllocations++;
+        return new PhyxVariable(this);
+    }
+
+    //reuse a released variable, it is already connected to its unit
+    PhyxVariable *variable = variablePool.pop();
+    variable->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL));
+    PhyxCompoundUnit::copyCompoundUnit(noUnit, variable->unit());
+    return variable;
+}
+
+void PhyxCalculator::releaseVariable(PhyxVariable *variable)
+{
+    if (variable != NULL)
+        variablePool.push(variable);
+}
+
+void PhyxCalculator::pushVariableCopy(PhyxVariable *source)
+{
+    if (source == NULL)
+    {
+        variableStack.push(NULL);
+        return;
+    }
+
+    PhyxVariable *variable = newVariable();
+    PhyxVariable::copyVariable(source, variable);
+    variable->unit()->setUnitSystem(unitSystem);    //shared variables point to the unit system of the base
+    variableStack.push(variable);
+}
+
+bool PhyxCalculator::integerOperands(int count) const
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (variableList.at(i)->valueType() != PhyxVariable::IntegerValue)
+            return false;
+    }
+    return true;
+}
+
+PhyxIntegerDataType PhyxCalculator::integerPower(PhyxIntegerDataType base, PhyxIntegerDataType exponent)
+{
+    PhyxIntegerDataType result = 1;
+    while (exponent > 0)
+    {
+        if (exponent & 1)
+            result *= base;
+        exponent >>= 1;
+        if (exponent > 0)
+            base *= base;
+    }
+    return result;
+}
+
 void PhyxCalculator::valueCheckComplex()
 {
     if (!popVariables(1))
@@ -1529,7 +1921,7 @@ void PhyxCalculator::valueCopy()
     if (!popVariables(1))
         return;
 
-    variableList[1] = new PhyxVariable(this);
+    variableList[1] = newVariable();
     PhyxVariable::copyVariable(variableList[0], variableList[1]);
 
     pushVariables(2,0);
@@ -1540,7 +1932,16 @@ void PhyxCalculator::valueAdd()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(variableList[0]->value() + variableList[1]->value());
+    if (variableList[0]->isReal() && variableList[1]->isReal())
+    {
+        PhyxFloatDataType result = variableList[0]->realValue() + variableList[1]->realValue();
+        if (integerOperands(2) && (std::fabs(result) < PHYX_INTEGER_EXACT_LIMIT))
+            variableList[0]->setIntegerValue(variableList[0]->toInt() + variableList[1]->toInt());
+        else
+            variableList[0]->setRealValue(result);
+    }
+    else
+        variableList[0]->setValue(variableList[0]->value() + variableList[1]->value());
 
     pushVariables(1,1);
 }
@@ -1550,7 +1951,16 @@ void PhyxCalculator::valueSub()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(variableList[0]->value() - variableList[1]->value());
+    if (variableList[0]->isReal() && variableList[1]->isReal())
+    {
+        PhyxFloatDataType result = variableList[0]->realValue() - variableList[1]->realValue();
+        if (integerOperands(2) && (std::fabs(result) < PHYX_INTEGER_EXACT_LIMIT))
+            variableList[0]->setIntegerValue(variableList[0]->toInt() - variableList[1]->toInt());
+        else
+            variableList[0]->setRealValue(result);
+    }
+    else
+        variableList[0]->setValue(variableList[0]->value() - variableList[1]->value());
 
     pushVariables(1,1);
 }
@@ -1560,7 +1970,16 @@ void PhyxCalculator::valueMul()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(variableList[0]->value() * variableList[1]->value());
+    if (variableList[0]->isReal() && variableList[1]->isReal())
+    {
+        PhyxFloatDataType result = variableList[0]->realValue() * variableList[1]->realValue();
+        if (integerOperands(2) && (std::fabs(result) < PHYX_INTEGER_EXACT_LIMIT))
+            variableList[0]->setIntegerValue(variableList[0]->toInt() * variableList[1]->toInt());
+        else
+            variableList[0]->setRealValue(result);
+    }
+    else
+        variableList[0]->setValue(variableList[0]->value() * variableList[1]->value());
 
     pushVariables(1,1);
 }
@@ -1570,7 +1989,17 @@ void PhyxCalculator::valueDiv()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(variableList[0]->value() / variableList[1]->value());
+    if (variableList[0]->isReal() && variableList[1]->isReal())
+    {
+        PhyxFloatDataType result = variableList[0]->realValue() / variableList[1]->realValue();
+        if (integerOperands(2) && (std::fabs(result) < PHYX_INTEGER_EXACT_LIMIT)
+                && (variableList[0]->toInt() % variableList[1]->toInt() == 0))
+            variableList[0]->setIntegerValue(variableList[0]->toInt() / variableList[1]->toInt());
+        else
+            variableList[0]->setRealValue(result);
+    }
+    else
+        variableList[0]->setValue(variableList[0]->value() / variableList[1]->value());
 
     pushVariables(1,1);
 }
@@ -1580,7 +2009,7 @@ void PhyxCalculator::valueMod()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(static_cast<PhyxFloatDataType>(variableList[0]->toInt() % variableList[1]->toInt()), PHYX_FLOAT_NULL));
+    variableList[0]->setIntegerValue(variableList[0]->toInt() % variableList[1]->toInt());
 
     pushVariables(1,1);
 }
@@ -1590,7 +2019,12 @@ void PhyxCalculator::valueNeg()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(-variableList[0]->value());
+    if (integerOperands(1) && (std::fabs(variableList[0]->realValue()) < PHYX_INTEGER_EXACT_LIMIT))
+        variableList[0]->setIntegerValue(-variableList[0]->toInt());
+    else if (variableList[0]->isReal())
+        variableList[0]->setRealValue(-variableList[0]->realValue());
+    else
+        variableList[0]->setValue(-variableList[0]->value());
 
     pushVariables(1,0);
 }
@@ -1616,10 +2050,11 @@ void PhyxCalculator::valuePow()
     if (!popVariables(2))
         return;
 
-    if (variableList[1]->value().imag() == PHYX_FLOAT_NULL)     // precision fix
-        variableList[0]->setValue(pow(variableList[0]->value(),variableList[1]->value().real()));
+    if (integerOperands(2) && (variableList[1]->toInt() >= 0)
+            && (std::pow(std::fabs(variableList[0]->realValue()), variableList[1]->realValue()) < PHYX_INTEGER_EXACT_LIMIT))
+        variableList[0]->setIntegerValue(integerPower(variableList[0]->toInt(), variableList[1]->toInt()));
     else
-        variableList[0]->setValue(pow(variableList[0]->value(),variableList[1]->value()));
+        variableList[0]->setValue(PhyxBatchPlan::powValue(variableList[0]->value(), variableList[1]->value()));
 
     pushVariables(1,1);
 }
@@ -1629,7 +2064,7 @@ void PhyxCalculator::valueSin()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(sin(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::sinValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1639,7 +2074,10 @@ void PhyxCalculator::valueArcsin()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(boost::math::asin(variableList[0]->value()));
+    if (variableList[0]->isReal() && (std::fabs(variableList[0]->realValue()) <= PHYX_FLOAT_ONE))
+        variableList[0]->setRealValue(std::asin(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(boost::math::asin(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1649,7 +2087,7 @@ void PhyxCalculator::valueCos()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(cos(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::cosValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1659,7 +2097,10 @@ void PhyxCalculator::valueArccos()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(boost::math::acos(variableList[0]->value()));
+    if (variableList[0]->isReal() && (std::fabs(variableList[0]->realValue()) <= PHYX_FLOAT_ONE))
+        variableList[0]->setRealValue(std::acos(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(boost::math::acos(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1669,7 +2110,7 @@ void PhyxCalculator::valueTan()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(tan(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::tanValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1679,7 +2120,10 @@ void PhyxCalculator::valueArctan()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(boost::math::atan(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(std::atan(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(boost::math::atan(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1689,7 +2133,10 @@ void PhyxCalculator::valueCot()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/tan(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::tan(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/tan(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1699,7 +2146,10 @@ void PhyxCalculator::valueArccot()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::atan(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::atan(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::atan(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1709,7 +2159,10 @@ void PhyxCalculator::valueSec()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/cos(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::cos(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/cos(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1719,7 +2172,10 @@ void PhyxCalculator::valueArcsec()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::acos(variableList[0]->value()));
+    if (variableList[0]->isReal() && (std::fabs(variableList[0]->realValue()) <= PHYX_FLOAT_ONE))
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::acos(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::acos(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1729,7 +2185,10 @@ void PhyxCalculator::valueCsc()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/sin(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::sin(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/sin(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1739,7 +2198,10 @@ void PhyxCalculator::valueArccsc()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::asin(variableList[0]->value()));
+    if (variableList[0]->isReal() && (std::fabs(variableList[0]->realValue()) <= PHYX_FLOAT_ONE))
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::asin(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::asin(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1749,7 +2211,7 @@ void PhyxCalculator::valueSinh()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(sinh(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::sinhValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1759,7 +2221,10 @@ void PhyxCalculator::valueArcsinh()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(boost::math::asinh(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(std::asinh(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(boost::math::asinh(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1769,7 +2234,7 @@ void PhyxCalculator::valueCosh()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(cosh(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::coshValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1779,7 +2244,10 @@ void PhyxCalculator::valueArccosh()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(boost::math::acosh(variableList[0]->value()));
+    if (variableList[0]->isReal() && (variableList[0]->realValue() >= PHYX_FLOAT_ONE))
+        variableList[0]->setRealValue(std::acosh(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(boost::math::acosh(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1789,7 +2257,7 @@ void PhyxCalculator::valueTanh()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(tanh(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::tanhValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1799,7 +2267,10 @@ void PhyxCalculator::valueArctanh()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(boost::math::atanh(variableList[0]->value()));
+    if (variableList[0]->isReal() && (std::fabs(variableList[0]->realValue()) < PHYX_FLOAT_ONE))
+        variableList[0]->setRealValue(std::atanh(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(boost::math::atanh(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1809,7 +2280,10 @@ void PhyxCalculator::valueCoth()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/tanh(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::tanh(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/tanh(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1819,7 +2293,10 @@ void PhyxCalculator::valueArccoth()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::atanh(variableList[0]->value()));
+    if (variableList[0]->isReal() && (std::fabs(variableList[0]->realValue()) < PHYX_FLOAT_ONE))
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::atanh(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::atanh(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1829,7 +2306,10 @@ void PhyxCalculator::valueSech()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/cosh(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::cosh(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/cosh(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1839,7 +2319,10 @@ void PhyxCalculator::valueArcsech()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::acosh(variableList[0]->value()));
+    if (variableList[0]->isReal() && (variableList[0]->realValue() >= PHYX_FLOAT_ONE))
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::acosh(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::acosh(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1849,7 +2332,10 @@ void PhyxCalculator::valueCsch()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/sinh(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::sinh(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/sinh(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1859,7 +2345,10 @@ void PhyxCalculator::valueArccsch()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::asinh(variableList[0]->value()));
+    if (variableList[0]->isReal())
+        variableList[0]->setRealValue(PHYX_FLOAT_ONE/std::asinh(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL)/boost::math::asinh(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1869,7 +2358,7 @@ void PhyxCalculator::valueExp()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(exp(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::expValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1879,7 +2368,7 @@ void PhyxCalculator::valueLn()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(log(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::lnValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1889,7 +2378,7 @@ void PhyxCalculator::valueLog10()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(log10(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::log10Value(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1899,7 +2388,10 @@ void PhyxCalculator::valueLog2()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(log(variableList[0]->value()));
+    if (variableList[0]->isReal() && (variableList[0]->realValue() > PHYX_FLOAT_NULL))
+        variableList[0]->setRealValue(std::log(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(log(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1909,7 +2401,11 @@ void PhyxCalculator::valueLogn()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(log(variableList[1]->value()) / log(variableList[0]->value()));
+    if (variableList[0]->isReal() && variableList[1]->isReal()
+            && (variableList[0]->realValue() > PHYX_FLOAT_NULL) && (variableList[1]->realValue() > PHYX_FLOAT_NULL))
+        variableList[0]->setRealValue(std::log(variableList[1]->realValue()) / std::log(variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(log(variableList[1]->value()) / log(variableList[0]->value()));
 
     pushVariables(1,1);
 }
@@ -1919,7 +2415,10 @@ void PhyxCalculator::valueRoot()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(exp(log(variableList[1]->value()) / variableList[0]->value()));
+    if (variableList[0]->isReal() && variableList[1]->isReal() && (variableList[1]->realValue() > PHYX_FLOAT_NULL))
+        variableList[0]->setRealValue(std::exp(std::log(variableList[1]->realValue()) / variableList[0]->realValue()));
+    else
+        variableList[0]->setValue(exp(log(variableList[1]->value()) / variableList[0]->value()));
 
     pushVariables(1,1);
 }
@@ -1929,7 +2428,7 @@ void PhyxCalculator::valueSqrt()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(sqrt(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::sqrtValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1939,7 +2438,7 @@ void PhyxCalculator::valueAbs()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(abs(variableList[0]->value()));
+    variableList[0]->setValue(PhyxBatchPlan::absValue(variableList[0]->value()));
 
     pushVariables(1,0);
 }
@@ -1952,12 +2451,12 @@ void PhyxCalculator::valueMax()
     if (variableList[0]->value().real() >= variableList[1]->value().real())
     {
         variableStack.push(variableList[0]);
-        variableList[1]->deleteLater();
+        releaseVariable(variableList[1]);
     }
     else
     {
         variableStack.push(variableList[1]);
-        variableList[0]->deleteLater();
+        releaseVariable(variableList[0]);
     }
 }
 
@@ -1969,12 +2468,12 @@ void PhyxCalculator::valueMin()
     if (variableList[0]->value().real()<= variableList[1]->value().real())
     {
         variableStack.push(variableList[0]);
-        variableList[1]->deleteLater();
+        releaseVariable(variableList[1]);
     }
     else
     {
         variableStack.push(variableList[1]);
-        variableList[0]->deleteLater();
+        releaseVariable(variableList[0]);
     }
 }
 
@@ -2016,7 +2515,7 @@ void PhyxCalculator::valueInt()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(PhyxValueDataType(static_cast<PhyxFloatDataType>(variableList[0]->toInt()),PHYX_FLOAT_NULL));
+    variableList[0]->setIntegerValue(variableList[0]->toInt());
 
     pushVariables(1,0);
 }
@@ -2190,8 +2689,8 @@ void PhyxCalculator::valueGcd()
     if (!popVariables(2))
         return;
 
-    PhyxIntegerDataType x = abs(variableList[0]->toInt());
-    PhyxIntegerDataType y = abs(variableList[1]->toInt());
+    PhyxIntegerDataType x = qAbs(variableList[0]->toInt());
+    PhyxIntegerDataType y = qAbs(variableList[1]->toInt());
 
     variableList[0]->setValue(PhyxValueDataType(static_cast<PhyxFloatDataType>(gcd(x,y)), PHYX_FLOAT_NULL));
 
@@ -2203,8 +2702,8 @@ void PhyxCalculator::valueLcm()
     if (!popVariables(2))
         return;
 
-    PhyxIntegerDataType x = abs(variableList[0]->toInt());
-    PhyxIntegerDataType y = abs(variableList[1]->toInt());
+    PhyxIntegerDataType x = qAbs(variableList[0]->toInt());
+    PhyxIntegerDataType y = qAbs(variableList[1]->toInt());
 
     variableList[0]->setValue(PhyxValueDataType(static_cast<PhyxFloatDataType>(lcm(x,y)), PHYX_FLOAT_NULL));
 
@@ -2348,7 +2847,7 @@ void PhyxCalculator::logicEqual()
     if (!popVariables(2))
         return;
 
-    variableList[2] = new PhyxVariable(this);
+    variableList[2] = newVariable();
     variableList[2]->setValue((variableList[0]->value() == variableList[1]->value()) && variableList[0]->unit()->isSame(variableList[1]->unit()));
     variableStack.push(variableList[2]);
 
@@ -2360,7 +2859,7 @@ void PhyxCalculator::logicNotEqual()
     if (!popVariables(2))
         return;
 
-    variableList[2] = new PhyxVariable(this);
+    variableList[2] = newVariable();
     variableList[2]->setValue((variableList[0]->value() != variableList[1]->value()) || !variableList[0]->unit()->isSame(variableList[1]->unit()));
     variableStack.push(variableList[2]);
 
@@ -2372,7 +2871,7 @@ void PhyxCalculator::logicGreater()
     if (!popVariables(2))
         return;
 
-    variableList[2] = new PhyxVariable(this);
+    variableList[2] = newVariable();
     variableList[2]->setValue(variableList[0]->value().real() > variableList[1]->value().real());
     variableStack.push(variableList[2]);
 
@@ -2384,7 +2883,7 @@ void PhyxCalculator::logicGreaterOrEqual()
     if (!popVariables(2))
         return;
 
-    variableList[2] = new PhyxVariable(this);
+    variableList[2] = newVariable();
     variableList[2]->setValue(variableList[0]->value().real() >= variableList[1]->value().real());
     variableStack.push(variableList[2]);
 
@@ -2396,7 +2895,7 @@ void PhyxCalculator::logicSmaller()
     if (!popVariables(2))
         return;
 
-    variableList[2] = new PhyxVariable(this);
+    variableList[2] = newVariable();
     variableList[2]->setValue(variableList[0]->value().real() < variableList[1]->value().real());
     variableStack.push(variableList[2]);
 
@@ -2408,7 +2907,7 @@ void PhyxCalculator::logicSmallerOrEqual()
     if (!popVariables(2))
         return;
 
-    variableList[2] = new PhyxVariable(this);
+    variableList[2] = newVariable();
     variableList[2]->setValue(variableList[0]->value().real() <= variableList[1]->value().real());
     variableStack.push(variableList[2]);
 
@@ -2420,7 +2919,7 @@ void PhyxCalculator::bitAnd()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(variableList[0]->toInt() & variableList[1]->toInt());
+    variableList[0]->setIntegerValue(variableList[0]->toInt() & variableList[1]->toInt());
 
     pushVariables(1,1);
 }
@@ -2430,7 +2929,7 @@ void PhyxCalculator::bitOr()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(variableList[0]->toInt() | variableList[1]->toInt());
+    variableList[0]->setIntegerValue(variableList[0]->toInt() | variableList[1]->toInt());
 
     pushVariables(1,1);
 }
@@ -2440,7 +2939,7 @@ void PhyxCalculator::bitXor()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(variableList[0]->toInt() ^ variableList[1]->toInt());
+    variableList[0]->setIntegerValue(variableList[0]->toInt() ^ variableList[1]->toInt());
 
     pushVariables(1,1);
 }
@@ -2450,7 +2949,7 @@ void PhyxCalculator::bitInv()
     if (!popVariables(1))
         return;
 
-    variableList[0]->setValue(~variableList[0]->toInt());
+    variableList[0]->setIntegerValue(~variableList[0]->toInt());
 
     pushVariables(1,0);
 }
@@ -2460,7 +2959,7 @@ void PhyxCalculator::bitShiftLeft()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(variableList[0]->toInt() << variableList[1]->toInt());
+    variableList[0]->setIntegerValue(variableList[0]->toInt() << variableList[1]->toInt());
 
     pushVariables(1,1);
 }
@@ -2470,7 +2969,7 @@ void PhyxCalculator::bitShiftRight()
     if (!popVariables(2))
         return;
 
-    variableList[0]->setValue(variableList[0]->toInt() >> variableList[1]->toInt());
+    variableList[0]->setIntegerValue(variableList[0]->toInt() >> variableList[1]->toInt());
 
     pushVariables(1,1);
 }
@@ -2483,15 +2982,15 @@ void PhyxCalculator::conditionIfElse()
     if (variableList[0]->toInt())
     {
         variableStack.push(variableList[1]);
-        variableList[2]->deleteLater();
+        releaseVariable(variableList[2]);
     }
     else
     {
         variableStack.push(variableList[2]);
-        variableList[1]->deleteLater();
+        releaseVariable(variableList[1]);
     }
 
-    variableList[0]->deleteLater();
+    releaseVariable(variableList[0]);
 }
 
 void PhyxCalculator::unitCheckDimensionless()
@@ -2665,7 +3164,7 @@ void PhyxCalculator::unitAdd()
         variableList[0]->unit()->simplify();
 
         PhyxUnit *unit = new PhyxUnit();
-        unit->setPowers(variableList[0]->unit()->powers());
+        unit->copyPowers(variableList[0]->unit());
         unit->setUnitGroup(unitGroupBuffer);
         unit->setPreferedPrefix(prefixBuffer);
         unit->setSymbol(stringBuffer);
@@ -2709,7 +3208,8 @@ void PhyxCalculator::variableRemove()
 
 void PhyxCalculator::variableLoad()
 {
-    variableStack.push(variableManager->getVariable(parameterBuffer));
+    recordRead("variable:" + parameterBuffer);
+    pushVariableCopy(variableManager->variables()->value(parameterBuffer, NULL));
     nameBuffer = parameterBuffer;
 }
 
@@ -2769,7 +3269,8 @@ void PhyxCalculator::constantRemove()
 
 void PhyxCalculator::constantLoad()
 {
-    variableStack.push(variableManager->getConstant(parameterBuffer));
+    recordRead("constant:" + parameterBuffer);
+    pushVariableCopy(variableManager->constants()->value(parameterBuffer, NULL));
     nameBuffer = parameterBuffer;
 }
 
@@ -2865,14 +3366,25 @@ void PhyxCalculator::listNorStart()
 
 void PhyxCalculator::listValueSave()
 {
-    stringBuffer = tr("current result");
-    variableAdd();
+    //the running result is kept out of the variable manager, binding it would change the lexicon on every list element
+    if (!popVariables(1))
+        return;
+
+    releaseVariable(listResult);
+    listResult = variableList[0];
+    recordWrite("list:result");
 }
 
 void PhyxCalculator::listValueLoad()
 {
-    parameterBuffer = tr("current result");
-    variableLoad();
+    if (listResult == NULL)
+    {
+        raiseException(ProgramError);
+        return;
+    }
+
+    recordRead("list:result");
+    pushVariableCopy(listResult);
 }
 
 void PhyxCalculator::listValueSwap()
@@ -2890,7 +3402,8 @@ void PhyxCalculator::listValueSwap()
 void PhyxCalculator::listEnd()
 {
     listModeActive = false;
-    variableManager->removeVariable(tr("current result"));
+    releaseVariable(listResult);
+    listResult = NULL;
 }
 
 bool PhyxCalculator::executeFunction(QString expression, QStringList parameters, bool verifyOnly = false)
@@ -2931,14 +3444,16 @@ bool PhyxCalculator::executeFunction(QString expression, QStringList parameters,
     }
     else
     {
-        success = /*this->setExpression(expression);*/ earleyParser->parseWord(expression);
+        functionParser->shareRules(earleyParser);
+        success = functionParser->parseWord(expression);
         if (success)
         {
             if (!verifyOnly)
             {
-                QList<EarleyTreeItem> earleyTree = earleyParser->getTree();                     //get a earley tree for the function
-                expressionCacheMap.insert(m_expression, earleyTreeToCacheItem(earleyTree, m_expression));
-                success = this->evaluate(earleyTree, m_expression, whiteSpaceList);
+                //evaluate the cache item, the tree points into rules a nested call may share again
+                ExpressionCacheItem cacheItem = earleyTreeToCacheItem(functionParser->getTree(), m_expression);
+                expressionCacheMap.insert(m_expression, cacheItem);
+                success = this->evaluate(cacheItem, whiteSpaceList);
             }
         }
     }
@@ -2978,14 +3493,16 @@ void PhyxCalculator::functionAdd()
     QString functionExpression = expressionBuffer;//parameterBuffer.mid(equalIndex+1);
     QStringList functionParameters;
     while (!functionParameterStack.isEmpty())
-    {
         functionParameters.append(functionParameterStack.pop());
-        valueBuffer = PhyxValueDataType(PHYX_FLOAT_ONE, PHYX_FLOAT_NULL);
-        pushVariable();     //for each parameter push 1 to stack for verifying the syntax of the expression
-    }
 
-    if (executeFunction(functionExpression, functionParameters, true))
+    CompiledFunction function;
+    if (compileFunction(functionExpression, functionParameters, &function))
+    {
         variableManager->addFunction(functionName, functionExpression, functionParameters);
+        compiledFunctions.insert(functionName, function);   //after addFunction, adding the rule drops the old compiled function
+    }
+    else
+        raiseException(SyntaxError);
 }
 
 void PhyxCalculator::functionRemove()
@@ -2997,26 +3514,142 @@ void PhyxCalculator::functionRemove()
 
 void PhyxCalculator::functionRun()
 {
-    //int clipIndex = parameterBuffer.indexOf("(");
-    QString functionName;//= parameterBuffer.left(clipIndex);
-    QStringList functionList = functions();
-    functionList.sort();
+    QString name = functionName(parameterBuffer);
+    PhyxVariableManager::PhyxFunction *function = variableManager->getFunction(name);
+    recordRead("function:" + name);
+    if (function == NULL)
+    {
+        raiseException(ProgramError);
+        return;
+    }
+
+    if (!compiledFunctions.contains(name))
+    {
+        CompiledFunction compiledFunction;
+        compileFunction(function->expression, function->parameters, &compiledFunction);
+        compiledFunctions.insert(name, compiledFunction);
+    }
+
+    callFunction(compiledFunctions.value(name), function->expression, function->parameters);
+}
+
+QString PhyxCalculator::functionName(QString text) const
+{
+    PhyxVariableManager::PhyxFunctionMap *functionMap = variableManager->functions();
+    int length = text.indexOf('(');
+    if (length == -1)
+        length = text.size();
+
+    for (; length > 0; length--)
+    {
+        if (functionMap->contains(text.left(length)))
+            return text.left(length);
+    }
+    return QString();
+}
+
+bool PhyxCalculator::compileFunction(QString expression, QStringList parameters, CompiledFunction *function)
+{
+    //the parameters are only made known to the lexicon copy of the function parser,
+    //so the item sets of earleyParser and the lexicon shared with other calculators stay untouched
+    functionParser->shareRules(earleyParser);
+    EarleySymbol variableLexicon = functionParser->lexiconSymbol("variable");
+    foreach (QString parameter, parameters)
+    {
+        if (!variableManager->containsVariable(parameter))
+            functionParser->addLexiconWord(variableLexicon, parameter);
+    }
+
+    QString strippedExpression = removeWhitespace(expression, &function->whiteSpaceList);
+    function->valid = functionParser->parseWord(strippedExpression);
+    function->usesSlots = false;
+    if (function->valid)
+    {
+        function->body = earleyTreeToCacheItem(functionParser->getTree(), strippedExpression);
+        function->usesSlots = bindParameterSlots(&function->body, parameters);
+    }
+
+    return function->valid;
+}
+
+bool PhyxCalculator::bindParameterSlots(ExpressionCacheItem *body, QStringList parameters)
+{
+    //functions that assign variables need their parameters bound by name
+    for (int i = 0; i < body->size(); i++)
+    {
+        int action = body->action(i);
+        if (action < 0)
+            continue;
+
+        QString name = actionNames.at(action);
+        if (name.startsWith("lowLevelAssignment") || name.startsWith("lowLevelCombinedAssignment")
+                || (name.startsWith("variable") && (name != "variableLoad"))
+                || (name == "constantAdd") || (name == "constantRemove")
+                || (name == "functionAdd") || (name == "functionRemove")
+                || (name == "listValueSave") || (name == "listEnd"))
+            return false;
+    }
 
-    for (int i = functionList.size()-1; i >= 0; i--)
+    int loadAction = actionNames.indexOf("variableLoad");
+    for (int i = 1; i < body->size(); i++)
     {
-        if (parameterBuffer.indexOf(functionList.at(i)) == 0)
+        if ((body->action(i) == loadAction) && (body->action(i-1) == PHYX_ACTION_BUFFER_PARAMETER))
         {
-            functionName = functionList.at(i);
-            break;
+            int slot = parameters.indexOf(body->parameter(i-1));
+            if (slot != -1)
+            {
+                body->actionList[i] = PHYX_ACTION_PARAMETER_LOAD;
+                body->slotList[i] = slot;
+            }
         }
     }
+    return true;
+}
+
+bool PhyxCalculator::callFunction(CompiledFunction function, QString expression, QStringList parameters)
+{
+    if (function.valid && function.usesSlots)
+        return runCompiledFunction(function, parameters.size());
+    else
+        return executeFunction(expression, parameters, false);
+}
+
+bool PhyxCalculator::runCompiledFunction(CompiledFunction function, int parameterCount)
+{
+    if (variableStack.size() < parameterCount)
+    {
+        raiseException(ProgramError);
+        return false;
+    }
+
+    //the first parameter is on top of the stack, like in executeFunction
+    int oldFrameBase = frameBase;
+    frameBase = frameVariables.size();
+    for (int i = 0; i < parameterCount; i++)
+        frameVariables.append(variableStack.pop());
+
+    bool success = this->evaluate(function.body, function.whiteSpaceList);
+
+    for (int i = frameBase; i < frameVariables.size(); i++)
+        releaseVariable(frameVariables.at(i));
+    frameVariables.resize(frameBase);
+    frameBase = oldFrameBase;
+
+    if (!success)
+    {
+        if (m_error)
+            noGuiUpdate = true;
+
+        raiseException(SyntaxError);
+        noGuiUpdate = false;
+    }
 
-    PhyxVariableManager::PhyxFunction *function = variableManager->getFunction(functionName);
-    executeFunction(function->expression, function->parameters);
+    return success;
 }
 
 void PhyxCalculator::bufferUnit()
 {
+    recordRead("unit:" + parameterBuffer);
     //get the unit
     unitBuffer = parameterBuffer;
 }
@@ -3073,6 +3706,7 @@ void PhyxCalculator::bufferBinString()
 
 void PhyxCalculator::bufferPrefix()
 {
+    recordRead("prefix:" + parameterBuffer);
     prefixBuffer = parameterBuffer;
 }
 
@@ -3092,13 +3726,14 @@ void PhyxCalculator::bufferExpression()
 
 void PhyxCalculator::bufferUnitGroup()
 {
+    recordRead("unitGroup:" + parameterBuffer);
     unitGroupBuffer = parameterBuffer;
 }
 
 void PhyxCalculator::pushVariable()
 {
     //create new variable
-    PhyxVariable *variable = new PhyxVariable(this);
+    PhyxVariable *variable = newVariable();
     variable->unit()->setUnitSystem(unitSystem);
     if (!unitBuffer.isEmpty())
         variable->setUnit(unitSystem->unit(unitBuffer));
@@ -3135,6 +3770,11 @@ void PhyxCalculator::pushVariable()
     else
         variable->setValue(valueBuffer / PhyxValueDataType(preferedPrefixValue,PHYX_FLOAT_NULL));
 
+    //integral literals start as integers, so the integer kernels can be used
+    if (variable->isReal() && (std::fabs(variable->realValue()) < PHYX_INTEGER_EXACT_LIMIT)
+            && (std::floor(variable->realValue()) == variable->realValue()))
+        variable->setIntegerValue(static_cast<PhyxIntegerDataType>(variable->realValue()));
+
     //push it to the stack
     variableStack.push(variable);
 
@@ -3165,7 +3805,8 @@ void PhyxCalculator::outputVariable()
                 if (!popVariables(1))
                     return;
 
-                //set the special variable #
+                //set the special variable #, the previous result goes back to the pool
+                releaseVariable(variableManager->takeVariable("#"));
                 variableManager->addVariable("#", variableList[0]);
                 //if (m_result != NULL)   // delete old result
                 //    delete m_result;
@@ -3322,6 +3963,9 @@ void PhyxCalculator::appendLowLevelOperation(QString variableName, PhyxCalculato
 
 void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *operation)
 {
+    if ((operation->type >= CombinedAssignmentOperationAdd) && (operation->type <= CombinedAssignmentOperationShiftRight))
+        recordRead("variable:" + operation->variableName);
+
     if (operation->type == AssignmentOperation)
     {
         variableManager->addVariable(operation->variableName, operation->variable);
@@ -3343,7 +3987,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationAdd)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitCheckConvertible();
         valueAdd();
@@ -3351,7 +3995,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationSub)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitCheckConvertible();
         valueSub();
@@ -3359,7 +4003,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationMul)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitMul();
         valueMul();
@@ -3367,7 +4011,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationDiv)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitDiv();
         valueDiv();
@@ -3375,7 +4019,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationMod)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitCheckDimensionless2();
         valueCheckInteger2();
@@ -3384,7 +4028,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationAnd)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitCheckDimensionless2();
         valueCheckInteger2();
@@ -3393,7 +4037,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationOr)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitCheckDimensionless2();
         valueCheckInteger2();
@@ -3402,7 +4046,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationXor)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitCheckDimensionless2();
         valueCheckInteger2();
@@ -3411,7 +4055,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationShiftLeft)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitCheckDimensionless2();
         valueCheckInteger2();
@@ -3420,7 +4064,7 @@ void PhyxCalculator::runLowLevelOperation(PhyxCalculator::LowLevelOperation *ope
     }
     else if (operation->type == CombinedAssignmentOperationShiftRight)
     {
-        variableStack.push(variableManager->getVariable(operation->variableName));
+        pushVariableCopy(variableManager->variables()->value(operation->variableName, NULL));
         variableStack.push(operation->variable);
         unitCheckDimensionless2();
         valueCheckInteger2();
@@ -3572,6 +4216,256 @@ void PhyxCalculator::lowLevelOutput()
     }
 }
 
+void PhyxCalculator::initializeBatchActions()
+{
+    BatchAction scalarAction = {BatchScalarAction, 0, PhyxBatchPlan::NoKernel};
+    batchActions.fill(scalarAction, actionNames.size());
+
+    setBatchAction("bufferValue",   BatchBufferAction, 0);
+    setBatchAction("bufferHex",     BatchBufferAction, 0);
+    setBatchAction("bufferOct",     BatchBufferAction, 0);
+    setBatchAction("bufferBin",     BatchBufferAction, 0);
+    setBatchAction("bufferUnit",    BatchBufferAction, 0);
+    setBatchAction("bufferPrefix",  BatchBufferAction, 0);
+    setBatchAction("pushVariable",  BatchBufferAction, 0);
+    setBatchAction("valuePi",       BatchBufferAction, 0);
+    setBatchAction("valueE",        BatchBufferAction, 0);
+    setBatchAction("valuePush1",    BatchBufferAction, 0);
+    setBatchAction("valuePush2",    BatchBufferAction, 0);
+    setBatchAction("valuePush3",    BatchBufferAction, 0);
+    setBatchAction("variableLoad",  BatchBufferAction, 0);
+    setBatchAction("constantLoad",  BatchBufferAction, 0);
+    setBatchAction("lowLevelRun",   BatchBufferAction, 0);
+    setBatchAction("lowLevelOutput", BatchBufferAction, 0);  //does nothing inside of functions
+
+    setBatchAction("unitCheckDimensionless",  BatchUnitAction, 1);
+    setBatchAction("unitCheckDimensionless2", BatchUnitAction, 2);
+    setBatchAction("unitCheckConvertible",    BatchUnitAction, 2);
+    setBatchAction("unitMul",                 BatchUnitAction, 2);
+    setBatchAction("unitDiv",                 BatchUnitAction, 2);
+    setBatchAction("unitSqrt",                BatchUnitAction, 1);
+    setBatchAction("unitClear",               BatchUnitAction, 1);
+    setBatchAction("unitPow",                 BatchUnitPowAction, 2);
+
+    setBatchAction("valueNeg",      BatchUnaryAction, 1, PhyxBatchPlan::NegKernel);
+    setBatchAction("valueSin",      BatchUnaryAction, 1, PhyxBatchPlan::SinKernel);
+    setBatchAction("valueCos",      BatchUnaryAction, 1, PhyxBatchPlan::CosKernel);
+    setBatchAction("valueTan",      BatchUnaryAction, 1, PhyxBatchPlan::TanKernel);
+    setBatchAction("valueSinh",     BatchUnaryAction, 1, PhyxBatchPlan::SinhKernel);
+    setBatchAction("valueCosh",     BatchUnaryAction, 1, PhyxBatchPlan::CoshKernel);
+    setBatchAction("valueTanh",     BatchUnaryAction, 1, PhyxBatchPlan::TanhKernel);
+    setBatchAction("valueExp",      BatchUnaryAction, 1, PhyxBatchPlan::ExpKernel);
+    setBatchAction("valueLn",       BatchUnaryAction, 1, PhyxBatchPlan::LnKernel);
+    setBatchAction("valueLog10",    BatchUnaryAction, 1, PhyxBatchPlan::Log10Kernel);
+    setBatchAction("valueSqrt",     BatchUnaryAction, 1, PhyxBatchPlan::SqrtKernel);
+    setBatchAction("valueAbs",      BatchUnaryAction, 1, PhyxBatchPlan::AbsKernel);
+
+    setBatchAction("valueAdd",      BatchBinaryAction, 2, PhyxBatchPlan::AddKernel);
+    setBatchAction("valueSub",      BatchBinaryAction, 2, PhyxBatchPlan::SubKernel);
+    setBatchAction("valueMul",      BatchBinaryAction, 2, PhyxBatchPlan::MulKernel);
+    setBatchAction("valueDiv",      BatchBinaryAction, 2, PhyxBatchPlan::DivKernel);
+    setBatchAction("valuePow",      BatchBinaryAction, 2, PhyxBatchPlan::PowKernel);
+    setBatchAction("valueNoPow",    BatchNoPowAction,  2, PhyxBatchPlan::PowKernel);
+
+    setBatchAction("valueCheckComplex",  BatchCheckComplexAction, 1);
+    setBatchAction("valueCheckComplex2", BatchCheckComplexAction, 2);
+}
+
+void PhyxCalculator::setBatchAction(QString name, PhyxCalculator::BatchActionType type, int operandCount, PhyxBatchPlan::Kernel kernel)
+{
+    int action = actionNames.indexOf(name);
+    if (action == -1)
+        return;
+
+    batchActions[action].type = type;
+    batchActions[action].operandCount = operandCount;
+    batchActions[action].kernel = kernel;
+}
+
+bool PhyxCalculator::planCompiledFunctionBatch(CompiledFunction function, PhyxCompoundUnit *parameterUnit, PhyxBatchPlan *plan)
+{
+    if (!function.valid || !function.usesSlots)
+        return false;
+
+    //every operand on the stack has a column, uniform operands have the same value for all samples and live on the stack only
+    QVector<bool> uniformColumns;
+    int stackBase = variableStack.size();
+    bool oldNoGuiUpdate = noGuiUpdate;
+    bool success = true;
+
+    plan->clear();
+    noGuiUpdate = true;
+    stackLevel++;
+
+    for (int i = 0; success && (i < function.body.size()); i++)
+    {
+        int action = function.body.action(i);
+
+        if (action == PHYX_ACTION_BUFFER_PARAMETER)
+        {
+            parameterBuffer = function.body.parameter(i);
+            continue;
+        }
+        else if (action == PHYX_ACTION_PARAMETER_LOAD)
+        {
+            PhyxVariable *variable = newVariable();
+            PhyxCompoundUnit::copyCompoundUnit(parameterUnit, variable->unit());
+            variableStack.push(variable);
+            plan->appendStep(PhyxBatchPlan::ParameterStep, uniformColumns.size());
+            uniformColumns.append(false);
+            continue;
+        }
+
+        const BatchAction &batchAction = batchActions.at(action);
+        int first = uniformColumns.size() - batchAction.operandCount;
+        if (first < 0)
+        {
+            success = false;
+            break;
+        }
+
+        bool uniform = true;
+        for (int j = ((batchAction.type == BatchScalarAction) ? 0 : first); j < uniformColumns.size(); j++)
+        {
+            if (!uniformColumns.at(j))
+                uniform = false;
+        }
+
+        if (uniform || (batchAction.type == BatchBufferAction))
+        {
+            //same as running the function for a single sample
+            (this->*actionTable.at(action))();
+            if (this->hasError() || (variableStack.size() < stackBase))
+            {
+                success = false;
+                break;
+            }
+
+            //the results of the action are uniform as well
+            uniformColumns.resize(variableStack.size() - stackBase);
+            for (int j = first; j < uniformColumns.size(); j++)
+                uniformColumns[j] = true;
+        }
+        else if (batchAction.type == BatchUnitAction || batchAction.type == BatchUnitPowAction)
+        {
+            if ((batchAction.type == BatchUnitPowAction) && !uniformColumns.last())
+            {
+                success = false;
+                break;
+            }
+
+            //the unit changes scale and offset the value, with the value i they show up as imaginary and real part
+            for (int j = first; j < uniformColumns.size(); j++)
+            {
+                if (!uniformColumns.at(j))
+                    variableStack.at(stackBase + j)->setValue(PhyxValueDataType(PHYX_FLOAT_NULL, PHYX_FLOAT_ONE));
+            }
+
+            (this->*actionTable.at(action))();
+            if (this->hasError() || ((variableStack.size() - stackBase) != uniformColumns.size()))
+            {
+                success = false;
+                break;
+            }
+
+            for (int j = first; j < uniformColumns.size(); j++)
+            {
+                PhyxValueDataType transformation = variableStack.at(stackBase + j)->value();
+                if (!uniformColumns.at(j) && (transformation != PhyxValueDataType(PHYX_FLOAT_NULL, PHYX_FLOAT_ONE)))
+                    plan->appendStep(PhyxBatchPlan::ScaleStep, j, PhyxBatchPlan::NoKernel, -1, transformation);
+            }
+        }
+        else if (batchAction.type == BatchUnaryAction)
+        {
+            plan->appendStep(PhyxBatchPlan::UnaryStep, uniformColumns.size() - 1, batchAction.kernel);
+        }
+        else if ((batchAction.type == BatchBinaryAction) || (batchAction.type == BatchNoPowAction))
+        {
+            int leftIndex = uniformColumns.size() - 2;
+            PhyxVariable *left = variableStack.at(stackBase + leftIndex);
+            PhyxVariable *right = variableStack.at(stackBase + leftIndex + 1);
+
+            if ((batchAction.type == BatchBinaryAction) || left->unit()->isOne())
+            {
+                if (uniformColumns.at(leftIndex))
+                    plan->appendStep(PhyxBatchPlan::BinaryStep, leftIndex, batchAction.kernel, 0, left->value());
+                else if (uniformColumns.at(leftIndex + 1))
+                    plan->appendStep(PhyxBatchPlan::BinaryStep, leftIndex, batchAction.kernel, 1, right->value());
+                else
+                    plan->appendStep(PhyxBatchPlan::BinaryStep, leftIndex, batchAction.kernel);
+                uniformColumns[leftIndex] = false;
+            }
+
+            releaseVariable(variableStack.pop());
+            uniformColumns.removeLast();
+        }
+        else if (batchAction.type == BatchCheckComplexAction)
+        {
+            for (int j = first; j < uniformColumns.size(); j++)
+            {
+                if (!uniformColumns.at(j))
+                    plan->appendStep(PhyxBatchPlan::CheckComplexStep, j);
+                else if (variableStack.at(stackBase + j)->isComplex())
+                    success = false;        //raised by the single sample path
+            }
+        }
+        else
+        {
+            success = false;
+        }
+    }
+
+    stackLevel--;
+
+    if (success && (uniformColumns.size() == 1))
+    {
+        if (uniformColumns.first())
+            plan->setUniformResult(variableStack.top()->value());
+    }
+    else
+        success = false;
+
+    while (variableStack.size() > stackBase)
+        releaseVariable(variableStack.pop());
+
+    //errors are raised again by the single sample path
+    m_error = false;
+    noGuiUpdate = oldNoGuiUpdate;
+
+    return success;
+}
+
+bool PhyxCalculator::runBatchPlan(const PhyxBatchPlan &plan, const PhyxValueColumn &parameterValues, PhyxValueColumn *result)
+{
+    int sampleCount = parameterValues.size();
+    result->resize(sampleCount);
+
+    //small datasets are not worth the threads
+    if (sampleCount <= PHYX_DATASET_CHUNK_SIZE)
+        return plan.run(parameterValues.constData(), result->data(), sampleCount);
+
+    //every chunk writes its own part of the result, the plan is only read
+    QAtomicInt finishedCount(0);
+    QAtomicInt failed(0);
+    const PhyxValueDataType *parameters = parameterValues.constData();
+    PhyxValueDataType *results = result->data();
+
+    for (int i = 0; i < sampleCount; i += PHYX_DATASET_CHUNK_SIZE)
+    {
+        int count = qMin(PHYX_DATASET_CHUNK_SIZE, sampleCount - i);
+        datasetThreadPool->start(new PhyxBatchChunk(&plan, parameters + i, results + i, count, &finishedCount, &datasetCanceled, &failed));
+    }
+
+    //keep the gui responsive, it may cancel the calculation
+    while (!datasetThreadPool->waitForDone(PHYX_DATASET_PROGRESS_INTERVAL))
+    {
+        emit datasetProgress(finishedCount.fetchAndAddOrdered(0), sampleCount);
+        QCoreApplication::processEvents();
+    }
+
+    return (failed.fetchAndAddOrdered(0) == 0) && (datasetCanceled.fetchAndAddOrdered(0) == 0);
+}
+
 void PhyxCalculator::calculateDataset(QString expression,
                                       QStringList parameters,
                                       PhyxVariable *startVariable,
@@ -3580,11 +4474,8 @@ void PhyxCalculator::calculateDataset(QString expression,
                                       PhyxVariableManager::DatasetType datasetType)
 {
     PhyxVariable *tmpVariable;
-    PhyxCompoundUnit *unit;
 
     PhyxVariableManager::PhyxDataset *dataset;
-    QList<PhyxValueDataType> xData;
-    QList<PhyxValueDataType> yData;
     PhyxCompoundUnit *xUnit;
     PhyxCompoundUnit *yUnit;
 
@@ -3618,41 +4509,33 @@ void PhyxCalculator::calculateDataset(QString expression,
         logParamStep = decade/step;
     }
 
+    datasetRunning = true;
+    datasetCanceled.fetchAndStoreOrdered(0);
+
     //initialize first run
-    tmpVariable = new PhyxVariable();
-    unit = new PhyxCompoundUnit();
-    PhyxCompoundUnit::copyCompoundUnit(startVariable->unit(), unit);
-    tmpVariable->setUnit(unit);
+    tmpVariable = newVariable();
+    PhyxCompoundUnit::copyCompoundUnit(startVariable->unit(), tmpVariable->unit());
     tmpVariable->setValue(PhyxValueDataType(value,PHYX_FLOAT_NULL));
     variableStack.push(tmpVariable);
 
+    //compile once, every run only binds the parameter
+    CompiledFunction function;
+    compileFunction(expression, parameters, &function);
+
     //execute first run
-    if (executeFunction(expression, parameters, false))
+    bool success = callFunction(function, expression, parameters);
+    if (success)
     {
         tmpVariable = variableStack.pop();
         PhyxCompoundUnit::copyCompoundUnit(tmpVariable->unit(), yUnit); //set y unit
-        tmpVariable->deleteLater();
+        releaseVariable(tmpVariable);
 
+        //sample the x values first, the units are the same for every sample
+        PhyxValueColumn xColumn;
+        PhyxValueColumn yColumn;
         while (value <= stop)
         {
-            //initialize
-            tmpVariable = new PhyxVariable();
-            unit = new PhyxCompoundUnit();
-            PhyxCompoundUnit::copyCompoundUnit(startVariable->unit(), unit);
-            tmpVariable->setUnit(unit);
-            tmpVariable->setValue(PhyxValueDataType(value,PHYX_FLOAT_NULL));
-            variableStack.push(tmpVariable);
-
-            //execute
-            if (executeFunction(expression, parameters,false))
-                tmpVariable = variableStack.pop();
-            else
-                return;
-
-            //save data
-            xData.append(PhyxValueDataType(value, PHYX_FLOAT_NULL));
-            yData.append(tmpVariable->value());
-            tmpVariable->deleteLater();
+            xColumn.append(PhyxValueDataType(value, PHYX_FLOAT_NULL));
 
             //increase value
             if (datasetType == PhyxVariableManager::LogarithmicDataset)
@@ -3664,20 +4547,67 @@ void PhyxCalculator::calculateDataset(QString expression,
                 value += step;
         }
 
-        dataset->unit.append(xUnit);
-        dataset->unit.append(yUnit);
-        dataset->data.append(xData);
-        dataset->data.append(yData);
+        //run the function for all samples at once, functions the batch can not handle run sample by sample
+        PhyxBatchPlan plan;
+        if ((parameters.size() != 1)
+                || !planCompiledFunctionBatch(function, startVariable->unit(), &plan)
+                || !runBatchPlan(plan, xColumn, &yColumn))
+        {
+            yColumn.clear();
+            yColumn.reserve(xColumn.size());
+            for (int j = 0; (j < xColumn.size()) && (datasetCanceled.fetchAndAddOrdered(0) == 0); j++)
+            {
+                //initialize
+                tmpVariable = newVariable();
+                PhyxCompoundUnit::copyCompoundUnit(startVariable->unit(), tmpVariable->unit());
+                tmpVariable->setValue(xColumn.at(j));
+                variableStack.push(tmpVariable);
+
+                //execute
+                if (!callFunction(function, expression, parameters))
+                {
+                    success = false;
+                    break;
+                }
+
+                tmpVariable = variableStack.pop();
+                yColumn.append(tmpVariable->value());
+                releaseVariable(tmpVariable);
+
+                if (((j + 1) % PHYX_DATASET_CHUNK_SIZE) == 0)
+                {
+                    emit datasetProgress(j + 1, xColumn.size());
+                    QCoreApplication::processEvents();
+                }
+            }
+        }
+        emit datasetProgress(xColumn.size(), xColumn.size());
+
+        if (datasetCanceled.fetchAndAddOrdered(0) != 0)
+            success = false;
+
+        if (success)
+        {
+            //save data
+            dataset->unit.append(xUnit);
+            dataset->unit.append(yUnit);
+            dataset->data.append(PhyxVariableManager::datasetColumn(xColumn));
+            dataset->data.append(PhyxVariableManager::datasetColumn(yColumn));
 
-        variableManager->addDataset(dataset);
-        emit datasetsChanged();
+            variableManager->addDataset(dataset);
+            emit datasetsChanged();
+        }
     }
-    else
+
+    //the dataset is only kept if all samples were calculated
+    if (!success)
     {
         delete dataset;
         delete xUnit;
         delete yUnit;
     }
+
+    datasetRunning = false;
 }
 
 void PhyxCalculator::datasetCreateStep()
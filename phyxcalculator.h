@@ -23,12 +23,18 @@
 #define _USE_MATH_DEFINES
 
 #include <QObject>
+#include <QCoreApplication>
 #include <QStack>
 #include <QDateTime>
 #include <QDebug>
 #include <QFile>
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QSharedPointer>
 #include <sstream>
-#include <boost/format.hpp>
+#include <cstdio>
+#include <clocale>
+#include <limits>
 #include <boost/math/complex.hpp>
 #include <boost/random/normal_distribution.hpp>
 #include <boost/random/mersenne_twister.hpp>
@@ -37,6 +43,7 @@
 #include "phyxunitsystem.h"
 #include "phyxvariable.h"
 #include "phyxvariablemanager.h"
+#include "phyxbatchplan.h"
 
 #ifndef Q_OS_SYMBIAN
 #include <boost/math/special_functions.hpp>
@@ -44,6 +51,13 @@
 
 typedef std::complex<PhyxFloatDataType>   PhyxValueDataType;      /// the base data type for values
 
+#define PHYX_SNAPSHOT_MAGIC     0x50585353  /// "PXSS", identifies a snapshot file
+#define PHYX_SNAPSHOT_VERSION   3           /// increase when the snapshot layout changes
+#define PHYX_ACTION_BUFFER_PARAMETER 0      /// action code of bufferParameter, handled inline by evaluate
+#define PHYX_ACTION_PARAMETER_LOAD   1      /// action code that loads a parameter of a compiled function from its slot
+#define PHYX_DATASET_CHUNK_SIZE 16384       /// number of samples a worker thread calculates at once
+#define PHYX_DATASET_PROGRESS_INTERVAL 50   /// milliseconds between two progress updates of a dataset calculation
+
 typedef struct {
     QStringList functions;                          /// a list of functions to call
 } PhyxRule;
@@ -62,6 +76,7 @@ class PhyxCalculator : public QObject
 
 public:
     explicit PhyxCalculator(QObject *parent = 0);
+    explicit PhyxCalculator(QSharedPointer<PhyxCalculator> base, QObject *parent = 0);    ///< shares grammar, units, variables and functions of base, only the changes are copied
 
     enum CalculationError {
         SyntaxError,
@@ -125,28 +140,54 @@ public:
         ListNorType
     };
 
+    enum BatchActionType {
+        BatchScalarAction,          /// runs only while every operand has the same value for all samples
+        BatchBufferAction,          /// does not read the stack
+        BatchUnitAction,            /// changes units, the samples follow the resulting scale and offset
+        BatchUnitPowAction,         /// changes units depending on the top operand, which must be the same for all samples
+        BatchUnaryAction,           /// runs a kernel on the top operand
+        BatchBinaryAction,          /// runs a kernel on the two top operands
+        BatchNoPowAction,           /// valueNoPow, decided by the unit of the base
+        BatchCheckComplexAction     /// checks that the operands are real
+    };
+
     typedef struct {
-        QStringList functionList;
+        QVector<int> actionList;
         QString expression;
         QList<int>  startPosList;
         QList<int>  endPosList;
+        QVector<int> slotList;      /// parameter slot of every PHYX_ACTION_PARAMETER_LOAD, -1 for other actions
 
-        QString const function(int pos) {
-            return functionList.at(pos);
+        int action(int pos) const {
+            return actionList.at(pos);
         }
         QString const parameter(int pos) {
             return expression.mid(startPosList.at(pos), endPosList.at(pos) - startPosList.at(pos) + 1);
         }
-        void appendItem(QString function, int startPos, int endPos) {
-            functionList.append(function);
+        void appendItem(int action, int startPos, int endPos) {
+            actionList.append(action);
             startPosList.append(startPos);
             endPosList.append(endPos);
+            slotList.append(-1);
         }
         int size() {
-            return functionList.size();
+            return actionList.size();
         }
     } ExpressionCacheItem;
 
+    typedef struct {
+        ExpressionCacheItem body;       /// the parsed expression, parameters are loaded from their slots
+        QList<int>  whiteSpaceList;     /// whitespace removed from the expression
+        bool        usesSlots;          /// false if the expression assigns variables, the parameters are then bound by name
+        bool        valid;              /// wheter the expression could be parsed
+    } CompiledFunction;
+
+    typedef struct {
+        BatchActionType type;
+        int         operandCount;   /// number of operands read from the stack
+        PhyxBatchPlan::Kernel kernel;   /// kernel of unary and binary actions
+    } BatchAction;
+
     typedef struct {
       PhyxFloatDataType numerator;
       PhyxFloatDataType denominator;
@@ -165,11 +206,11 @@ public:
 
     typedef QList<LowLevelOperation*>    LowLevelOperationList;
 
-    bool setExpression (QString m_expression);          ///< sets the expression, checks what must be parsed and returns wheter the expression is parsable or not
-    bool evaluate();
-    bool evaluate(QList<EarleyTreeItem> earleyTree, const QString expression, const QList<int> whiteSpaceList);                                    ///< evaluates the expression
-    bool evaluate(ExpressionCacheItem cacheItem, const QList<int> whiteSpaceList);
+    bool setExpression (QString m_expression);          ///< sets the expression, checks what must be parsed and returns wheter the expression is parsable or not, returns false while a dataset is calculated
+    bool evaluate();                                    ///< evaluates the expression, does nothing while a dataset is calculated
     void loadFile(QString fileName);                    ///< parses a complete txt file
+    bool loadSnapshot(QString fileName, QStringList sourceFiles);   ///< restores grammar, units, variables and functions from a snapshot, returns false if it is missing or was built from other source files
+    bool saveSnapshot(QString fileName, QStringList sourceFiles);   ///< writes grammar, units, variables and functions to a snapshot tagged with a hash of the source files
 
     PhyxVariable * variable(QString name) const;
     PhyxVariable * constant(QString name) const;
@@ -216,9 +257,27 @@ public:
     {
         return m_result;
     }
+    int allocationCount() const             ///< returns the count of stack variables allocated, stays constant when evaluating in steady state
+    {
+        return variableAllocations;
+    }
+    bool isCalculatingDataset() const
+    {
+        return datasetRunning;
+    }
+    QSet<QString> readSymbols() const
+    {
+        return m_readSymbols;
+    }
+    QSet<QString> writtenSymbols() const
+    {
+        return m_writtenSymbols;
+    }
 
     static QString complexToString(const PhyxValueDataType number, int precision, char numberFormat, QString imaginaryUnit, bool useBraces = false, bool useFractions = false);
     static PhyxValueDataType stringToComplex(QString string);
+    static QString floatToString(PhyxFloatDataType number, int precision, char numberFormat);  ///< printf style formatting that always uses a decimal point
+    static PhyxFloatDataType stringToFloat(const QChar *data, int length);                     ///< parses a decimal literal, exact powers of ten are applied directly
     static PhyxIntegerDataType hexToLongInt(QString string);
     static PhyxIntegerDataType octToLongInt(QString string);
     static PhyxIntegerDataType binToLongInt(QString string);
@@ -231,11 +290,15 @@ public:
     static PhyxIntegerDataType lcm(PhyxIntegerDataType x, PhyxIntegerDataType y);  ///< returns the lowest common multiple of x and y
     static PhyxFloatDataType toInt(PhyxFloatDataType x);
     static PhyxFraction decimalToFraction(PhyxFloatDataType decimal, PhyxFloatDataType accuracyFactor);
+    static QString stripComments(QString text);                                ///< strips all comments from the text
 
     ResultVariable formatVariable(PhyxVariable *variable, OutputMode outputMode, PrefixMode prefixMode, int precision, char numberFormat, QString imaginaryUnit, bool useFractions) const;
 
 private:
     QStack<PhyxVariable*>       variableStack;                                  /// stack for variable calculation
+    QStack<PhyxVariable*>       variablePool;                                   /// released stack variables, reused instead of allocating new ones
+    PhyxCompoundUnit            *noUnit;                                        /// unit of a fresh stack variable, used to reset pooled variables
+    int                         variableAllocations;                            /// count of stack variables allocated because the pool was empty
     QStack<LowLevelOperationList*> lowLevelStack;                               /// stack for low level operations
     QStack<QString>             functionParameterStack;                         /// stack for storing paramters for function definition
     QList<PhyxVariable*>        variableList;                                   /// list containing currently loaded variables
@@ -253,13 +316,16 @@ private:
     QHash<QString, PhyxRule>    phyxRules;                                      /// map of all rules, key is rule
 
     QEarleyParser               *earleyParser;                                  /// the earley parser
+    QEarleyParser               *functionParser;                                /// parses function bodies without discarding the item sets of earleyParser
     PhyxUnitSystem              *unitSystem;                                    /// the unit system
     PhyxVariableManager         *variableManager;                               /// the variable manager
+    QSharedPointer<PhyxCalculator> m_base;                                      /// calculator the base state is shared with, kept alive as long as this calculator
 
     QList<int>                  expressionWhitespaceList;                       /// this list holds count of removed whitespace for each character of the expression
 
     bool                        listModeActive;                                 /// holds whete list mode is active or not
     ListOperationType           listModeType;                                   /// holds current list operation type
+    PhyxVariable                *listResult;                                    /// holds the running result of the current list operation
 
     bool                        noGuiUpdate;                                    /// if this variable is set, no GUI update should be performed (e.g. when running functions)
 
@@ -272,22 +338,44 @@ private:
     int                         m_errorNumber;                                  /// current error number
     int                         m_errorStartPosition;                           /// position where the error occured
     int                         m_errorEndPosition;                             /// end position of the error
+    QSet<QString>               m_readSymbols;                                  /// symbols the last evaluation read, like "variable:x" or "unit:m"
+    QSet<QString>               m_writtenSymbols;                               /// symbols the last evaluation defined or removed
 
 
-    QHash<QString, void (PhyxCalculator::*)()> functionMap;                     /// functions mapped with their names
+    QHash<QString, void (PhyxCalculator::*)()> functionMap;                     /// functions mapped with their names, resolved to action codes once
+    QVector<void (PhyxCalculator::*)()> actionTable;                            /// functions indexed by their action code
+    QStringList                 actionNames;                                    /// function names indexed by their action code
     QMap<QString, ExpressionCacheItem > expressionCacheMap;                   /// a cache for faster execution of expressions
+    QHash<QString, CompiledFunction> compiledFunctions;                         /// user functions compiled on their first call, key is the function name
+    QVector<PhyxVariable*>      frameVariables;                                 /// arguments of the running compiled functions
+    int                         frameBase;                                      /// index of the first argument of the innermost running compiled function
+    QVector<BatchAction>        batchActions;                                   /// batch behaviour indexed by action code
+    QThreadPool                 *datasetThreadPool;                             /// worker threads for dataset calculations
+    QAtomicInt                  datasetCanceled;                                /// set if the running dataset calculation should stop
+    bool                        datasetRunning;                                 /// holds wheter a dataset is being calculated
     QStringList                 standardFunctionList;                           /// a stringlist containing all standard function names
 
     ExpressionCacheItem const earleyTreeToCacheItem(QList<EarleyTreeItem> const earleyTree, const QString expression);
+    bool evaluate(QList<EarleyTreeItem> earleyTree, const QString expression, const QList<int> whiteSpaceList);                                    ///< evaluates the expression
+    bool evaluate(ExpressionCacheItem cacheItem, const QList<int> whiteSpaceList);                                                                ///< runs the actions of a cached expression, also used while a dataset is calculated
 
-    void initialize();                                                          ///< initializes PhyxCalculator
+    void initialize(const PhyxCalculator *base = 0);                            ///< initializes PhyxCalculator, loads the grammar or shares it with base
     void loadGrammar(QString fileName);                                         ///< loads the grammar from a file
-    QString stripComments(QString text);                                        ///< strips all comments from the text
+    static QByteArray snapshotHash(QStringList sourceFiles);                   ///< hashes the files a snapshot is built from
     QString removeWhitespace(QString text, QList<int> *whiteSpaceList);         ///< removes the whitespace of a string and saves the count
     int restoreErrorPosition(int pos, QList<int> whiteSpaceList);               ///< restores the original position of an error in expression
 
     void raiseException(int errorNumber);                                       ///< raises an exception
+    void recordRead(QString symbol);                                            ///< records a symbol the evaluation depends on
+    void recordWrite(QString symbol);                                           ///< records a symbol the evaluation changes
     void addRule(QString rule, QString functions = "");                         ///< adds a rule
+    void addRule(QString premise, QVector<EarleySymbol> conclusion, QString functions); ///< adds a rule given as symbols, used for the rules of user definitions
+    void removeRule(QString premise, QVector<EarleySymbol> conclusion);         ///< removes a rule given as symbols
+    void addLexiconRule(QString premise, QString functions);                   ///< adds a lexicon and a rule matching its words to the premise
+    void addLexiconWord(QString lexicon, QString word);                         ///< adds a word to a lexicon of user definitions
+    void removeLexiconWord(QString lexicon, QString word);                      ///< removes a word from a lexicon of user definitions
+    static QVector<EarleySymbol> literalSymbols(QString string);               ///< converts a string to terminal symbols
+    QVector<EarleySymbol> functionRuleSymbols(QString name, int parameterCount) const; ///< returns the conclusion of the rule of a custom function
 
     PhyxUnitSystem::PhyxPrefix getBestPrefix(PhyxFloatDataType value, PhyxFloatDataType power, QString unitGroup, QString preferedPrefix) const;     ///< gets the best fitting prefix
 
@@ -298,6 +386,11 @@ private:
 
     bool popVariables(int count);                       /// checks wheter enough variables are in the stack and loads them
     void pushVariables(int count, int deleteCount);     /// push the given number of variables to the stack and delete the given number
+    PhyxVariable *newVariable();                        /// returns a fresh stack variable, taken from the pool if possible
+    void releaseVariable(PhyxVariable *variable);       /// returns a stack variable that is no longer needed to the pool
+    void pushVariableCopy(PhyxVariable *source);        /// pushes a copy of a stored variable or constant to the stack
+    bool integerOperands(int count) const;              /// checks if the first count loaded variables hold exact integers
+    static PhyxIntegerDataType integerPower(PhyxIntegerDataType base, PhyxIntegerDataType exponent);   /// exponentiation by squaring for small integer results
 
     /** functions for value calculation */
     void valueCheckComplex();
@@ -457,6 +550,15 @@ private:
 
     /** functions for function handling */
     bool executeFunction(QString expression, QStringList parameters, bool verifyOnly);
+    bool compileFunction(QString expression, QStringList parameters, CompiledFunction *function);  ///< parses a function once and binds its parameters to slots, returns wheter it is parsable
+    bool bindParameterSlots(ExpressionCacheItem *body, QStringList parameters); ///< replaces the loads of the parameters with slot loads, returns false if the body assigns variables
+    bool callFunction(CompiledFunction function, QString expression, QStringList parameters);   ///< runs a compiled function with the arguments on the stack
+    bool runCompiledFunction(CompiledFunction function, int parameterCount);  ///< runs a function whose parameters are bound to slots
+    QString functionName(QString text) const;          ///< returns the longest name of a user function text starts with
+    void initializeBatchActions();                                              ///< sets the batch behaviour of the actions
+    void setBatchAction(QString name, BatchActionType type, int operandCount, PhyxBatchPlan::Kernel kernel = PhyxBatchPlan::NoKernel);
+    bool planCompiledFunctionBatch(CompiledFunction function, PhyxCompoundUnit *parameterUnit, PhyxBatchPlan *plan);    ///< resolves the units of a function of one parameter and builds the plan for its values, returns false if the function can not run as batch
+    bool runBatchPlan(const PhyxBatchPlan &plan, const PhyxValueColumn &parameterValues, PhyxValueColumn *result);     ///< runs a plan in chunks on the worker threads, returns false if a chunk failed or the calculation was canceled
     void functionAdd();
     void functionRemove();
     void functionRun();
@@ -528,6 +630,7 @@ signals:
     void prefixesChanged();         ///< is emited when prefixes have changed
     void functionsChanged();        ///< is emited when functions have changed
     void datasetsChanged();         ///< is emited when datasets have changed
+    void datasetProgress(int value, int maximum);   ///< is emited while a dataset is calculated
     void outputResult();            ///< is emited when result should be output
     void outputError();             ///< is emited when an error should be output
     void outputText(QString text);  ///< is emited when text should be output
@@ -537,6 +640,7 @@ signals:
     
 public slots:
     void clearVariables();
+    void cancelDataset();           ///< stops the running dataset calculation, the dataset is discarded
 
 private slots:
     void addUnitRule(QString symbol);
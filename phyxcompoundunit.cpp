@@ -22,6 +22,7 @@
 PhyxCompoundUnit::PhyxCompoundUnit(QObject *parent) :
     PhyxUnit(parent)
 {
+    m_unitSystem = NULL;
 }
 
 PhyxCompoundUnit::~PhyxCompoundUnit()
@@ -35,21 +36,64 @@ PhyxCompoundUnit::~PhyxCompoundUnit()
 
 void PhyxCompoundUnit::copyCompoundUnit(PhyxCompoundUnit *source, PhyxCompoundUnit *destination)
 {
-    destination->setPowers(source->powers());
+    destination->copyPowers(source);
     destination->setUnitSystem(source->unitSystem());
     destination->setScaleFactor(source->scaleFactor());
     destination->setOffset(source->offset());
     destination->setCompounds(source->compounds());//copyCompounds(source));
 }
 
+void PhyxCompoundUnit::save(QDataStream &stream) const
+{
+    PhyxUnit::save(stream);
+
+    stream << static_cast<qint32>(m_compounds.size());
+    for (int i = 0; i < m_compounds.size(); i++)
+    {
+        m_compounds.at(i).unit->save(stream);
+        PhyxUnit::saveFloat(stream, m_compounds.at(i).power);
+    }
+}
+
+void PhyxCompoundUnit::load(QDataStream &stream)
+{
+    qint32 compoundCount;
+
+    PhyxUnit::load(stream);
+
+    m_compounds.clear();
+    stream >> compoundCount;
+    for (int i = 0; (i < compoundCount) && (stream.status() == QDataStream::Ok); i++)
+    {
+        PhyxUnit *unit = new PhyxUnit();
+        unit->load(stream);
+
+        if ((m_unitSystem != NULL) && m_unitSystem->containsUnit(unit->symbol()))   // compounds point to the units of the system
+        {
+            PhyxUnit *systemUnit = m_unitSystem->unit(unit->symbol());
+            delete unit;
+            unit = systemUnit;
+        }
+        else if (m_unitSystem != NULL)     // copies of this unit share the compound pointers, so the unit belongs to the system
+            unit->setParent(m_unitSystem);
+        else
+            unit->setParent(this);
+
+        PhyxCompound compound;
+        compound.unit = unit;
+        compound.power = PhyxUnit::loadFloat(stream);
+        m_compounds.append(compound);
+    }
+}
+
 bool PhyxCompoundUnit::isSame(PhyxCompoundUnit *unit)
 {
-    return (this->powersCompare(unit->powers()) && (compoundsCompare(unit->compounds())));//m_compounds == unit->compounds()));
+    return (this->powersCompare(unit) && (compoundsCompare(unit->compounds())));//m_compounds == unit->compounds()));
 }
 
 bool PhyxCompoundUnit::isConvertible(PhyxCompoundUnit *unit)
 {
-    return this->powersCompare(unit->powers());
+    return this->powersCompare(unit);
 }
 
 bool PhyxCompoundUnit::isOne()
@@ -114,11 +158,7 @@ void PhyxCompoundUnit::compoundSimplify(int index)
     else
     {
 
-        PhyxUnit *tmpUnit = new PhyxUnit();
-        copyUnit(unit,tmpUnit);
-        tmpUnit->setOffset(PHYX_FLOAT_NULL);
-        tmpUnit->setScaleFactor(PHYX_FLOAT_ONE);
-        PhyxUnit *newUnit = m_unitSystem->verifyUnit(tmpUnit);
+        PhyxUnit *newUnit = m_unitSystem->verifyPowers(unit);
         if (newUnit != NULL)
         {
             compoundDivide(unit, power);    //remove old unit
@@ -128,7 +168,6 @@ void PhyxCompoundUnit::compoundSimplify(int index)
         {
             compoundStrip(index);             //strip compound
         }
-        tmpUnit->deleteLater();
     }
 }
 
@@ -172,8 +211,7 @@ void PhyxCompoundUnit::compoundStrip(int index)
 {
     PhyxCompound compound = m_compounds.at(index);
     compoundDivide(compound.unit, compound.power); //remove the old unit
-    PowerMap *powers = compound.unit->powers();
-    QMapIterator<QString, PhyxFloatDataType> i(*powers);
+    QMapIterator<QString, PhyxFloatDataType> i(compound.unit->powers());
     while (i.hasNext())
     {
        i.next();
@@ -288,10 +326,7 @@ void PhyxCompoundUnit::verify()
     {
         if (!(this->isSimpleUnit() || this->isOne()))
         {
-            PhyxUnit *unit = new PhyxUnit();
-            unit->setPowers(this->powers());
-            PhyxUnit *newUnit = m_unitSystem->verifyUnit(unit);
-            unit->deleteLater();
+            PhyxUnit *newUnit = m_unitSystem->verifyPowers(this);
             if (newUnit != NULL)
             {
                 compoundsSetNull();
@@ -332,7 +367,7 @@ void PhyxCompoundUnit::multiply(PhyxCompoundUnit *unit)
     if (unit->isDimensionlessUnit())
         unit->simplify();
 
-    this->powersMultiply(unit->powers());
+    this->powersMultiply(unit);
     this->compoundsMultiply(unit->compounds());
 
     verify();
@@ -347,7 +382,7 @@ void PhyxCompoundUnit::divide(PhyxCompoundUnit *unit)
     if (unit->isDimensionlessUnit())
         unit->simplify();
 
-    this->powersDivide(unit->powers());
+    this->powersDivide(unit);
     this->compoundsDivide(unit->compounds());
 
     verify();
@@ -390,7 +425,7 @@ void PhyxCompoundUnit::fromSimpleUnit(PhyxUnit *unit)
 {
     compoundsClear();
     compoundAppend(unit,PHYX_FLOAT_ONE);
-    setPowers(unit->powers());
+    copyPowers(unit);
 }
 
 void PhyxCompoundUnit::simplify()
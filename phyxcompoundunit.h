@@ -74,6 +74,9 @@ public:
 
     static void copyCompoundUnit(PhyxCompoundUnit *source, PhyxCompoundUnit *destination);
 
+    void save(QDataStream &stream) const;               ///< writes the unit and its compounds to a snapshot stream
+    void load(QDataStream &stream);                     ///< reads the unit from a snapshot stream, compounds are resolved against the unit system
+
     QString const symbol();
     QString const preferedPrefix();                     ///< this overloaded function returns the prefered prefix if unit is a simple unit
     QString const unitGroup();                          ///< this overloaded function returns the unit group of the unit if the unit is a simple unit
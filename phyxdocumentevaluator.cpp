@@ -0,0 +1,143 @@
+/**************************************************************************
+**
+** This file is part of PhyxCalc.
+**
+** PhyxCalc is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** PhyxCalc is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with PhyxCalc.  If not, see <http://www.gnu.org/licenses/>.
+**
+***************************************************************************/
+
+#include "phyxdocumentevaluator.h"
+
+PhyxDocumentEvaluator::PhyxDocumentEvaluator(PhyxCalculator *calculator, QObject *parent) :
+    QObject(parent)
+{
+    if (calculator == NULL)
+        calculator = new PhyxCalculator(this);
+    m_calculator = calculator;
+
+    //same defaults as the settings of the application
+    m_outputMode = PhyxCalculator::MinimizeUnitOutputMode;
+    m_prefixMode = PhyxCalculator::UsePrefix;
+    m_precision = 6;
+    m_numberFormat = 'g';
+    m_imaginaryUnit = "i";
+    m_useFractions = false;
+    m_unitLoader = NULL;
+    m_currentLine = -1;
+
+    connect(m_calculator, SIGNAL(outputResult()),
+            this, SLOT(outputResult()));
+    connect(m_calculator, SIGNAL(outputError()),
+            this, SLOT(outputError()));
+    connect(m_calculator, SIGNAL(outputConverted(QString)),
+            this, SLOT(outputConverted(QString)));
+    connect(m_calculator, SIGNAL(outputText(QString)),
+            this, SLOT(outputText(QString)));
+}
+
+PhyxDocumentEvaluator::LineOutputList PhyxDocumentEvaluator::evaluate(const QStringList &lines)
+{
+    bool inComment = false;     //inside a multi line comment
+
+    m_outputs.clear();
+    for (m_currentLine = 0; m_currentLine < lines.size(); m_currentLine++)
+    {
+        QString line = lines.at(m_currentLine).trimmed();
+        if (m_unitLoader != NULL)
+            line = m_unitLoader->replaceSymbols(line);
+
+        if (inComment)
+        {
+            if (!line.contains("*/"))
+                continue;
+            inComment = false;
+        }
+        if (!line.isEmpty() && (line.at(0) == '='))
+            continue;
+
+        int commentStart = line.lastIndexOf("/*");
+        if ((commentStart != -1) && (line.indexOf("*/", commentStart) == -1))
+            inComment = true;
+
+        //empty lines are passed too, they end the list mode
+        m_calculator->setExpression(line);
+        if (!m_calculator->expression().isEmpty())
+            m_calculator->evaluate();
+    }
+    m_currentLine = -1;
+
+    LineOutputList outputs = m_outputs;
+    m_outputs.clear();
+    return outputs;
+}
+
+PhyxDocumentEvaluator::LineOutput PhyxDocumentEvaluator::newOutput(OutputType type) const
+{
+    LineOutput output;
+    output.line = m_currentLine;
+    output.type = type;
+    output.rawValue = m_calculator->resultValue();
+    output.rawUnit = m_calculator->resultUnit();
+    output.errorNumber = 0;
+    output.errorStartPosition = -1;
+    output.errorEndPosition = -1;
+    return output;
+}
+
+void PhyxDocumentEvaluator::outputResult()
+{
+    PhyxCalculator::ResultVariable result = m_calculator->formatVariable(m_calculator->result(),
+                                                                         m_outputMode,
+                                                                         m_prefixMode,
+                                                                         m_precision,
+                                                                         m_numberFormat,
+                                                                         m_imaginaryUnit,
+                                                                         m_useFractions);
+    LineOutput output = newOutput(ResultOutput);
+    output.value = result.value;
+    output.unit = result.unit;
+    m_outputs.append(output);
+}
+
+void PhyxDocumentEvaluator::outputError()
+{
+    LineOutput output = newOutput(ErrorOutput);
+    output.errorNumber = m_calculator->errorNumber();
+    output.errorString = m_calculator->errorString();
+    output.errorStartPosition = m_calculator->errorStartPosition();
+    output.errorEndPosition = m_calculator->errorEndPosition();
+    m_outputs.append(output);
+}
+
+void PhyxDocumentEvaluator::outputText(QString text)
+{
+    LineOutput output = newOutput(TextOutput);
+    output.text = text;
+    m_outputs.append(output);
+}
+
+void PhyxDocumentEvaluator::outputConverted(QString text)
+{
+    PhyxCalculator::ResultVariable result = m_calculator->formatVariable(m_calculator->result(),
+                                                                         m_outputMode,
+                                                                         m_prefixMode,
+                                                                         m_precision,
+                                                                         m_numberFormat,
+                                                                         m_imaginaryUnit,
+                                                                         m_useFractions);
+    LineOutput output = newOutput(ConvertedOutput);
+    output.value = result.value;
+    output.unit = text;
+    m_outputs.append(output);
+}
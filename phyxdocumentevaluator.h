@@ -0,0 +1,156 @@
+/**************************************************************************
+**
+** This file is part of PhyxCalc.
+**
+** PhyxCalc is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** PhyxCalc is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with PhyxCalc.  If not, see <http://www.gnu.org/licenses/>.
+**
+***************************************************************************/
+
+#ifndef PHYXDOCUMENTEVALUATOR_H
+#define PHYXDOCUMENTEVALUATOR_H
+
+#include <QObject>
+#include <QStringList>
+#include <QList>
+#include "phyxcalculator.h"
+#include "unitloader.h"
+
+/// evaluates the lines of a document without a text editor, the outputs of the calculator are collected
+/// as structured results instead of being written into the document
+/// the calculator must not be connected to a LineParser at the same time, it would output the results too
+class PhyxDocumentEvaluator : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(PhyxCalculator::OutputMode outputMode READ outputMode WRITE setOutputMode)
+    Q_PROPERTY(PhyxCalculator::PrefixMode prefixMode READ prefixMode WRITE setPrefixMode)
+    Q_PROPERTY(int precision READ precision WRITE setPrecision)
+    Q_PROPERTY(char numberFormat READ numberFormat WRITE setNumberFormat)
+    Q_PROPERTY(QString imaginaryUnit READ imaginaryUnit WRITE setImaginaryUnit)
+    Q_PROPERTY(bool useFractions READ useFractions WRITE setUseFractions)
+    Q_PROPERTY(UnitLoader *unitLoader READ unitLoader WRITE setUnitLoader)
+
+public:
+    enum OutputType {
+        ResultOutput,           /// a value with its unit
+        ConvertedOutput,        /// a value converted into a requested unit
+        TextOutput,             /// text, like the output of a list
+        ErrorOutput             /// an error
+    };
+
+    typedef struct {
+        int                 line;               /// index of the line in the evaluated list
+        OutputType          type;
+        QString             value;              /// the formatted value
+        QString             unit;               /// the formatted or converted unit
+        QString             text;               /// the output of text outputs
+        PhyxValueDataType   rawValue;           /// the value in base units
+        QString             rawUnit;            /// the unit of the raw value
+        int                 errorNumber;
+        QString             errorString;
+        int                 errorStartPosition;
+        int                 errorEndPosition;
+    } LineOutput;
+
+    typedef QList<LineOutput> LineOutputList;
+
+    explicit PhyxDocumentEvaluator(PhyxCalculator *calculator = 0, QObject *parent = 0);   ///< creates an own calculator if none is given
+
+    LineOutputList evaluate(const QStringList &lines);     ///< evaluates the lines in order, lines starting with "=" are treated as old results and skipped
+
+    PhyxCalculator *calculator() const
+    {
+        return m_calculator;
+    }
+    PhyxCalculator::OutputMode outputMode() const
+    {
+        return m_outputMode;
+    }
+    PhyxCalculator::PrefixMode prefixMode() const
+    {
+        return m_prefixMode;
+    }
+    int precision() const
+    {
+        return m_precision;
+    }
+    char numberFormat() const
+    {
+        return m_numberFormat;
+    }
+    QString imaginaryUnit() const
+    {
+        return m_imaginaryUnit;
+    }
+    bool useFractions() const
+    {
+        return m_useFractions;
+    }
+    UnitLoader * unitLoader() const
+    {
+        return m_unitLoader;
+    }
+
+private:
+    PhyxCalculator              *m_calculator;
+    PhyxCalculator::OutputMode  m_outputMode;
+    PhyxCalculator::PrefixMode  m_prefixMode;
+    int                         m_precision;
+    char                        m_numberFormat;
+    QString                     m_imaginaryUnit;
+    bool                        m_useFractions;
+    UnitLoader                  *m_unitLoader;          /// replaces names like alpha with their symbols before a line is evaluated, like in the editor
+
+    LineOutputList              m_outputs;              /// outputs of the running evaluation
+    int                         m_currentLine;          /// line of the running evaluation
+
+    LineOutput newOutput(OutputType type) const;
+
+public slots:
+    void setOutputMode(PhyxCalculator::OutputMode arg)
+    {
+        m_outputMode = arg;
+    }
+    void setPrefixMode(PhyxCalculator::PrefixMode arg)
+    {
+        m_prefixMode = arg;
+    }
+    void setPrecision(int arg)
+    {
+        m_precision = arg;
+    }
+    void setNumberFormat(char arg)
+    {
+        m_numberFormat = arg;
+    }
+    void setImaginaryUnit(QString arg)
+    {
+        m_imaginaryUnit = arg;
+    }
+    void setUseFractions(bool arg)
+    {
+        m_useFractions = arg;
+    }
+    void setUnitLoader(UnitLoader * arg)
+    {
+        m_unitLoader = arg;
+    }
+
+private slots:
+    void outputResult();
+    void outputError();
+    void outputText(QString text);
+    void outputConverted(QString text);
+};
+
+#endif // PHYXDOCUMENTEVALUATOR_H
@@ -19,6 +19,9 @@
 
 #include "phyxunit.h"
 
+QHash<QString, int>  PhyxUnit::baseIndices;
+QStringList          PhyxUnit::baseNames;
+
 PhyxUnit::PhyxUnit(QObject *parent) :
     QObject(parent)
 {
@@ -29,142 +32,245 @@ PhyxUnit::PhyxUnit(QObject *parent) :
     m_offset = PHYX_FLOAT_NULL;
     m_scaleFactor = PHYX_FLOAT_ONE;
     m_flags = 0;
-    m_powers = new PowerMap();
+    m_extraPowers = NULL;
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+        m_dimensions[i] = PHYX_FLOAT_NULL;
 }
 
 PhyxUnit::~PhyxUnit()
 {
-    delete m_powers;
+    delete m_extraPowers;
 }
 
-void PhyxUnit::powerAppend(QString base, PhyxFloatDataType power)
+int PhyxUnit::baseIndex(QString base)
 {
-    m_powers->insert(base, power);
+    QHash<QString, int>::const_iterator it = baseIndices.constFind(base);
+    if (it != baseIndices.constEnd())
+        return it.value();
+
+    baseNames.append(base);
+    baseIndices.insert(base, baseNames.size()-1);
+    return baseNames.size()-1;
 }
 
-void PhyxUnit::powerMultiply(QString base, PhyxFloatDataType factor)
+void PhyxUnit::powerAppend(QString base, PhyxFloatDataType power)
 {
-    PhyxFloatDataType power;
-    if (m_powers->contains(base))
-    {
-        power = m_powers->value(base);
-        power += factor;
-    }
+    int index = baseIndex(base);
+    if (index < PHYX_DIMENSION_COUNT)
+        m_dimensions[index] = power;
     else
     {
-        power = factor;
+        if (m_extraPowers == NULL)
+            m_extraPowers = new PowerMap();
+        m_extraPowers->insert(base, power);
     }
-
-    if (power == PHYX_FLOAT_NULL)
-        m_powers->remove(base);
-    else
-        m_powers->insert(base, power);
 }
 
-void PhyxUnit::powerDivide(QString base, PhyxFloatDataType factor)
+void PhyxUnit::powerMultiply(QString base, PhyxFloatDataType factor)
 {
-    /*PhyxFloatDataType power;
-    if (m_powers->contains(base))
+    int index = baseIndex(base);
+    if (index < PHYX_DIMENSION_COUNT)
     {
-        power = m_powers->value(base);
-        power -= factor;
-    }
-    else
-    {
-        power = -factor;
+        m_dimensions[index] += factor;
+        return;
     }
 
+    if (m_extraPowers == NULL)
+        m_extraPowers = new PowerMap();
+
+    PhyxFloatDataType power = m_extraPowers->value(base, PHYX_FLOAT_NULL) + factor;
     if (power == PHYX_FLOAT_NULL)
-        m_powers->remove(base);
+        m_extraPowers->remove(base);
     else
-        m_powers->insert(base, power);*/
+        m_extraPowers->insert(base, power);
+}
+
+void PhyxUnit::powerDivide(QString base, PhyxFloatDataType factor)
+{
     powerMultiply(base, -factor);
 }
 
-void PhyxUnit::powersMultiply(PhyxUnit::PowerMap *powers)
+void PhyxUnit::powersMultiply(const PhyxUnit *unit)
 {
-    QMapIterator<QString, PhyxFloatDataType> i(*powers);
-     while (i.hasNext()) {
-         i.next();
-         powerMultiply(i.key(), i.value());
-     }
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+        m_dimensions[i] += unit->m_dimensions[i];
+
+    if (unit->m_extraPowers != NULL)
+    {
+        QMapIterator<QString, PhyxFloatDataType> i(*unit->m_extraPowers);
+        while (i.hasNext()) {
+            i.next();
+            powerMultiply(i.key(), i.value());
+        }
+    }
 }
 
-void PhyxUnit::powersDivide(PowerMap *powers)
+void PhyxUnit::powersDivide(const PhyxUnit *unit)
 {
-    QMapIterator<QString, PhyxFloatDataType> i(*powers);
-     while (i.hasNext()) {
-         i.next();
-         powerDivide(i.key(), i.value());
-     }
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+        m_dimensions[i] -= unit->m_dimensions[i];
+
+    if (unit->m_extraPowers != NULL)
+    {
+        QMapIterator<QString, PhyxFloatDataType> i(*unit->m_extraPowers);
+        while (i.hasNext()) {
+            i.next();
+            powerDivide(i.key(), i.value());
+        }
+    }
 }
 
 void PhyxUnit::powersRaise(PhyxFloatDataType power)
 {
-    QMapIterator<QString, PhyxFloatDataType> i(*m_powers);
-     while (i.hasNext()) {
-         i.next();
-         m_powers->insert(i.key(), i.value() * power);
-     }
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+        m_dimensions[i] *= power;
+
+    if (m_extraPowers != NULL)
+    {
+        QMutableMapIterator<QString, PhyxFloatDataType> i(*m_extraPowers);
+        while (i.hasNext()) {
+            i.next();
+            i.setValue(i.value() * power);
+        }
+    }
 }
 
 void PhyxUnit::powersRoot(PhyxFloatDataType root)
 {
-    QMapIterator<QString, PhyxFloatDataType> i(*m_powers);
-     while (i.hasNext()) {
-         i.next();
-         m_powers->insert(i.key(), i.value() / root);
-     }
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+        m_dimensions[i] /= root;
+
+    if (m_extraPowers != NULL)
+    {
+        QMutableMapIterator<QString, PhyxFloatDataType> i(*m_extraPowers);
+        while (i.hasNext()) {
+            i.next();
+            i.setValue(i.value() / root);
+        }
+    }
 }
 
-bool PhyxUnit::powersCompare(PhyxUnit::PowerMap *powers)
+bool PhyxUnit::powersCompare(const PhyxUnit *unit) const
 {
-    return *m_powers == *powers;
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+    {
+        if (m_dimensions[i] != unit->m_dimensions[i])
+            return false;
+    }
+
+    // a missing map and an empty map are the same
+    if ((m_extraPowers == NULL) || m_extraPowers->isEmpty())
+        return ((unit->m_extraPowers == NULL) || unit->m_extraPowers->isEmpty());
+    if (unit->m_extraPowers == NULL)
+        return false;
+    return *m_extraPowers == *unit->m_extraPowers;
 }
 
 void PhyxUnit::powersClear()
 {
-    m_powers->clear();
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+        m_dimensions[i] = PHYX_FLOAT_NULL;
+
+    if (m_extraPowers != NULL)
+        m_extraPowers->clear();
 }
 
-bool PhyxUnit::isOne()
+void PhyxUnit::copyPowers(const PhyxUnit *unit)
 {
-    return ((m_scaleFactor == PHYX_FLOAT_ONE) && (m_offset == PHYX_FLOAT_NULL) && (m_powers->isEmpty()));
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+        m_dimensions[i] = unit->m_dimensions[i];
+
+    if (unit->m_extraPowers != NULL)
+    {
+        if (m_extraPowers == NULL)
+            m_extraPowers = new PowerMap();
+        *m_extraPowers = *unit->m_extraPowers;
+    }
+    else if (m_extraPowers != NULL)
+        m_extraPowers->clear();
 }
 
-bool PhyxUnit::isBaseUnit()
+int PhyxUnit::powersCount() const
 {
-    if (((m_scaleFactor == PHYX_FLOAT_ONE) && (m_offset == PHYX_FLOAT_NULL) && (m_powers->size() == 1)))
+    int count = 0;
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
     {
-        QMapIterator<QString, PhyxFloatDataType> i(*m_powers);
-        i.next();
-        if (i.value() == PHYX_FLOAT_ONE)
-            return true;
-        else
-            return false;
+        if (m_dimensions[i] != PHYX_FLOAT_NULL)
+            count++;
     }
-    else
+
+    if (m_extraPowers != NULL)
+        count += m_extraPowers->size();
+    return count;
+}
+
+bool PhyxUnit::hasBasePowers() const
+{
+    if (powersCount() != 1)
         return false;
+
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+    {
+        if (m_dimensions[i] != PHYX_FLOAT_NULL)
+            return (m_dimensions[i] == PHYX_FLOAT_ONE);
+    }
+    return (m_extraPowers->constBegin().value() == PHYX_FLOAT_ONE);
+}
+
+uint PhyxUnit::dimensionHash() const
+{
+    // powers are mostly small fractions, scaling by 2520 keeps halves, thirds, ... apart
+    uint hash = 0;
+    for (int i = 0; i < PHYX_DIMENSION_COUNT; i++)
+        hash = hash * 31 + static_cast<uint>(qRound64(static_cast<double>(m_dimensions[i]) * 2520.0));
+
+    if (m_extraPowers != NULL)
+        hash += m_extraPowers->size();
+    return hash;
+}
+
+PhyxUnit::PowerMap PhyxUnit::powers() const
+{
+    PowerMap powerMap;
+    for (int i = 0; (i < PHYX_DIMENSION_COUNT) && (i < baseNames.size()); i++)
+    {
+        if (m_dimensions[i] != PHYX_FLOAT_NULL)
+            powerMap.insert(baseNames.at(i), m_dimensions[i]);
+    }
+
+    if (m_extraPowers != NULL)
+        powerMap.unite(*m_extraPowers);
+    return powerMap;
+}
+
+bool PhyxUnit::isOne()
+{
+    return ((m_scaleFactor == PHYX_FLOAT_ONE) && (m_offset == PHYX_FLOAT_NULL) && (powersCount() == 0));
+}
+
+bool PhyxUnit::isBaseUnit()
+{
+    return ((m_scaleFactor == PHYX_FLOAT_ONE) && (m_offset == PHYX_FLOAT_NULL) && hasBasePowers());
 }
 
 bool PhyxUnit::isDimensionlessUnit()
 {
-    return ((m_offset == PHYX_FLOAT_NULL) && (m_powers->isEmpty()));
+    return ((m_offset == PHYX_FLOAT_NULL) && (powersCount() == 0));
 }
 
 bool PhyxUnit::isProductUnit()
 {
-    return ((m_scaleFactor == PHYX_FLOAT_ONE) && (m_offset == PHYX_FLOAT_NULL) && (m_powers->size() >= 1));
+    return ((m_scaleFactor == PHYX_FLOAT_ONE) && (m_offset == PHYX_FLOAT_NULL) && (powersCount() >= 1));
 }
 
 bool PhyxUnit::isGalileanUnit()
 {
-    return (((m_scaleFactor != PHYX_FLOAT_ONE) || (m_offset != PHYX_FLOAT_NULL)) && (m_powers->size() >= 1));
+    return (((m_scaleFactor != PHYX_FLOAT_ONE) || (m_offset != PHYX_FLOAT_NULL)) && (powersCount() >= 1));
 }
 
 bool PhyxUnit::isConvertible(PhyxUnit *unit)
 {
-    return powersCompare(unit->powers());
+    return powersCompare(unit);
 }
 
 bool PhyxUnit::isSame(PhyxUnit *unit)
@@ -173,12 +279,12 @@ bool PhyxUnit::isSame(PhyxUnit *unit)
         return false;
     if (this->scaleFactor() != unit->scaleFactor())
         return false;
-    return powersCompare(unit->powers());
+    return powersCompare(unit);
 }
 
 void PhyxUnit::copyUnit(PhyxUnit *source, PhyxUnit *destination)
 {
-    destination->setPowers(source->powers());
+    destination->copyPowers(source);
     destination->setSymbol(source->symbol());
     destination->setOffset(source->offset());
     destination->setScaleFactor(source->scaleFactor());
@@ -187,10 +293,60 @@ void PhyxUnit::copyUnit(PhyxUnit *source, PhyxUnit *destination)
     destination->setUnitGroup(source->unitGroup());
 }
 
+void PhyxUnit::save(QDataStream &stream) const
+{
+    stream << m_symbol << m_name << m_unitGroup << m_preferedPrefix << static_cast<qint32>(m_flags);
+    saveFloat(stream, m_offset);
+    saveFloat(stream, m_scaleFactor);
+
+    PowerMap powerMap = powers();
+    stream << static_cast<qint32>(powerMap.size());
+    QMapIterator<QString, PhyxFloatDataType> i(powerMap);
+    while (i.hasNext())
+    {
+        i.next();
+        stream << i.key();
+        saveFloat(stream, i.value());
+    }
+}
+
+void PhyxUnit::load(QDataStream &stream)
+{
+    qint32 flags;
+    qint32 powerCount;
+
+    stream >> m_symbol >> m_name >> m_unitGroup >> m_preferedPrefix >> flags;
+    m_flags = UnitFlags(flags);
+    m_offset = loadFloat(stream);
+    m_scaleFactor = loadFloat(stream);
+
+    powersClear();
+    stream >> powerCount;
+    for (int i = 0; (i < powerCount) && (stream.status() == QDataStream::Ok); i++)
+    {
+        QString base;
+        stream >> base;
+        powerAppend(base, loadFloat(stream));
+    }
+}
+
+void PhyxUnit::saveFloat(QDataStream &stream, PhyxFloatDataType value)
+{
+    stream.writeRawData(reinterpret_cast<const char*>(&value), sizeof(PhyxFloatDataType));
+}
+
+PhyxFloatDataType PhyxUnit::loadFloat(QDataStream &stream)
+{
+    PhyxFloatDataType value = PHYX_FLOAT_NULL;
+    if (stream.readRawData(reinterpret_cast<char*>(&value), sizeof(PhyxFloatDataType)) != sizeof(PhyxFloatDataType))
+        stream.setStatus(QDataStream::ReadPastEnd);
+    return value;
+}
+
 QString PhyxUnit::dimensionString() const       //this can't handle units with prefered prefix
 {
     QString outputString;
-    QMapIterator<QString, PhyxFloatDataType> i(*m_powers);
+    QMapIterator<QString, PhyxFloatDataType> i(powers());
     while (i.hasNext())
     {
         i.next();
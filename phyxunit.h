@@ -22,8 +22,13 @@
 
 #include <QObject>
 #include <QMap>
+#include <QHash>
+#include <QStringList>
+#include <QDataStream>
 #include "global.h"
 
+#define PHYX_DIMENSION_COUNT    16      /// base units held in the dense dimension vector, further base units are kept in a map
+
 class PhyxUnit : public QObject
 {
     Q_OBJECT
@@ -32,7 +37,7 @@ class PhyxUnit : public QObject
     //Q_PROPERTY(UnitType type READ type WRITE setType)
     Q_PROPERTY(PhyxFloatDataType offset READ offset WRITE setOffset)
     Q_PROPERTY(PhyxFloatDataType scaleFactor READ scaleFactor WRITE setScaleFactor)
-    Q_PROPERTY(PowerMap *powers READ powers WRITE setPowers)
+    Q_PROPERTY(PowerMap powers READ powers WRITE setPowers)
     //Q_PROPERTY(double prefixPower READ prefixPower WRITE setPrefixPower)
     Q_PROPERTY(UnitFlags flags READ flags WRITE setFlags)
     Q_PROPERTY(QString unitGroup READ unitGroup WRITE setUnitGroup)
@@ -63,15 +68,21 @@ public:
 
     typedef QMap<QString, PhyxFloatDataType> PowerMap;
 
-    void powerAppend(QString base, PhyxFloatDataType power);        /// adds a power to the map
+    void powerAppend(QString base, PhyxFloatDataType power);        /// sets the power of a base unit
     void powerMultiply(QString base, PhyxFloatDataType factor);     /// multiplies a power with factor
     void powerDivide(QString base, PhyxFloatDataType factor);       /// devides a power with factor
-    void powersMultiply(PowerMap *powers);                           /// multiplies powers of the unit with other powers
-    void powersDivide(PowerMap *powers);                             /// devides powers of the unit with other powers
+    void powersMultiply(const PhyxUnit *unit);                      /// multiplies powers of the unit with the powers of another unit
+    void powersDivide(const PhyxUnit *unit);                        /// devides powers of the unit with the powers of another unit
     void powersRaise(PhyxFloatDataType power);                      /// raises all powers to power
     void powersRoot(PhyxFloatDataType root);                        /// takes the root of all powers
-    bool powersCompare(PowerMap *powers);                            /// compares powers of the unit with other powers and returns ==
+    bool powersCompare(const PhyxUnit *unit) const;                 /// compares powers of the unit with the powers of another unit and returns ==
     void powersClear();                                             /// clears all powers
+    void copyPowers(const PhyxUnit *unit);                          /// copies the powers of another unit
+    int  powersCount() const;                                       /// returns the count of base units with a power
+    bool hasBasePowers() const;                                     /// returns wheter the powers are the powers of a single base unit
+    uint dimensionHash() const;                                     /// returns a hash of the powers, units with the same powers have the same hash
+
+    static int baseIndex(QString base);                             /// returns the index of a base unit in the dimension vector, unknown base units are added
 
     /*void prefixMultiply(double factor);
     void prefixDevide(double factor);
@@ -89,6 +100,12 @@ public:
 
     static void copyUnit(PhyxUnit *source, PhyxUnit *destination);
 
+    void save(QDataStream &stream) const;               ///< writes the unit to a snapshot stream
+    void load(QDataStream &stream);                     ///< reads the unit from a snapshot stream
+
+    static void saveFloat(QDataStream &stream, PhyxFloatDataType value);   ///< writes a float in its native representation, QDataStream has no long double operator
+    static PhyxFloatDataType loadFloat(QDataStream &stream);               ///< reads a float written by saveFloat
+
     QString dimensionString() const;                    ///< returns a string with the dimensional representation of the unit (e.g. m^2*kg^-1)
 
     QString     symbol() const
@@ -111,10 +128,7 @@ public:
     {
         return m_flags;
     }
-    PowerMap   *powers() const
-    {
-        return m_powers;
-    }
+    PowerMap    powers() const;                         ///< returns the powers mapped with the names of their base units, for display and iteration
     QString unitGroup() const
     {
         return m_unitGroup;
@@ -129,7 +143,8 @@ private:
     QString     m_name;                    /// the name of the unit
     PhyxFloatDataType      m_offset;       /// offset for OffsetUnit and GalileanUnit
     PhyxFloatDataType      m_scaleFactor;  /// scale factor for GalileanUnit and LogarithmicUnit
-    PowerMap    *m_powers;                  /// this map holds the powers of the base units
+    PhyxFloatDataType      m_dimensions[PHYX_DIMENSION_COUNT];  /// powers of the base units, index is baseIndex
+    PowerMap    *m_extraPowers;             /// powers of the base units behind the dimension vector, NULL if there are none
     //double      m_prefixPower;             /// for Si units -> the power of the prefix (10^x)
     UnitFlags   m_flags;                   /// flags of the unit
 
@@ -137,6 +152,9 @@ private:
 
     QString m_preferedPrefix;
 
+    static QHash<QString, int>  baseIndices;    /// index of every base unit name
+    static QStringList          baseNames;      /// base unit names, index is baseIndex
+
 signals:
     
 public slots:
@@ -161,12 +179,15 @@ void setFlags(UnitFlags arg)
 {
     m_flags = arg;
 }
-void setPowers(PowerMap *arg)
+void setPowers(PowerMap arg)
 {
-    m_powers->clear();
-    for (int i = 0; i < arg->keys().size(); i++)
-        m_powers->insert(arg->keys().at(i), arg->value(arg->keys().at(i)));
-   // m_powers = arg;
+    powersClear();
+    QMapIterator<QString, PhyxFloatDataType> i(arg);
+    while (i.hasNext())
+    {
+        i.next();
+        powerAppend(i.key(), i.value());
+    }
 }
 void setUnitGroup(QString arg)
 {
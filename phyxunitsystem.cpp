@@ -31,20 +31,23 @@ PhyxUnitSystem::~PhyxUnitSystem()
     while (i.hasNext())
     {
         i.next();
-        i.value()->deleteLater();
+        releaseUnit(i.value());
     }
     QMapIterator<QString, PhyxUnit*> i2(derivedUnitsMap);
     while (i2.hasNext())
     {
         i2.next();
-        i2.value()->deleteLater();
+        releaseUnit(i2.value());
     }
 }
 
 void PhyxUnitSystem::addBaseUnit(QString symbol, PhyxUnit::UnitFlags flags, QString unitGroup, QString preferedPrefix)
 {
     if (baseUnitsMap.contains(symbol))
-        baseUnitsMap.take(symbol)->deleteLater();
+    {
+        unindexUnit(&baseUnitIndex, baseUnitsMap.value(symbol));
+        releaseUnit(baseUnitsMap.take(symbol));
+    }
 
    PhyxUnit *unit = new PhyxUnit();
    unit->setSymbol(symbol);
@@ -53,10 +56,12 @@ void PhyxUnitSystem::addBaseUnit(QString symbol, PhyxUnit::UnitFlags flags, QStr
    unit->setUnitGroup(unitGroup);
    unit->setPreferedPrefix(preferedPrefix);
    baseUnitsMap.insert(symbol, unit);
+   indexUnit(&baseUnitIndex, unit);
 
     if (derivedUnitsMap.contains(symbol))
     {
-        derivedUnitsMap.take(symbol)->deleteLater();
+        unindexUnit(&derivedUnitIndex, derivedUnitsMap.value(symbol));
+        releaseUnit(derivedUnitsMap.take(symbol));
         recalculate();
     }
 
@@ -89,12 +94,19 @@ void PhyxUnitSystem::addBaseUnit(QString symbol, PhyxUnit::UnitFlags flags, QStr
 void PhyxUnitSystem::addDerivedUnit(PhyxUnit *unit)
 {
     if (baseUnitsMap.contains(unit->symbol()))
-        baseUnitsMap.take(unit->symbol())->deleteLater();
+    {
+        unindexUnit(&baseUnitIndex, baseUnitsMap.value(unit->symbol()));
+        releaseUnit(baseUnitsMap.take(unit->symbol()));
+    }
 
     if (derivedUnitsMap.contains(unit->symbol()))
-        derivedUnitsMap.take(unit->symbol())->deleteLater();
+    {
+        unindexUnit(&derivedUnitIndex, derivedUnitsMap.value(unit->symbol()));
+        releaseUnit(derivedUnitsMap.take(unit->symbol()));
+    }
 
    derivedUnitsMap.insert(unit->symbol(), unit);
+   indexUnit(&derivedUnitIndex, unit);
    recalculate();
 
    emit unitAdded(unit->symbol());
@@ -103,10 +115,16 @@ void PhyxUnitSystem::addDerivedUnit(PhyxUnit *unit)
 bool PhyxUnitSystem::removeUnit(QString symbol)
 {
     if (baseUnitsMap.contains(symbol))
-        baseUnitsMap.take(symbol)->deleteLater();
+    {
+        unindexUnit(&baseUnitIndex, baseUnitsMap.value(symbol));
+        releaseUnit(baseUnitsMap.take(symbol));
+    }
 
     if (derivedUnitsMap.contains(symbol))
-        derivedUnitsMap.take(symbol)->deleteLater();
+    {
+        unindexUnit(&derivedUnitIndex, derivedUnitsMap.value(symbol));
+        releaseUnit(derivedUnitsMap.take(symbol));
+    }
 
     recalculate();
 
@@ -190,6 +208,11 @@ PhyxUnit *PhyxUnitSystem::unit(QString symbol) const
         return new PhyxUnit();
 }
 
+bool PhyxUnitSystem::containsUnit(QString symbol) const
+{
+    return (baseUnitsMap.contains(symbol) || derivedUnitsMap.contains(symbol));
+}
+
 PhyxUnitSystem::PhyxUnitMap PhyxUnitSystem::units() const
 {
     PhyxUnitMap map;
@@ -251,60 +274,177 @@ QList<PhyxUnitSystem::PhyxPrefix> PhyxUnitSystem::prefixes(QString unitGroup) co
 
 PhyxUnit *PhyxUnitSystem::verifyUnit(PhyxUnit *unit) const
 {
-    if (unit->isBaseUnit())
+    return findUnit(unit, unit->isBaseUnit(), unit->scaleFactor(), unit->offset());
+}
+
+PhyxUnit *PhyxUnitSystem::verifyPowers(const PhyxUnit *unit) const
+{
+    return findUnit(unit, unit->hasBasePowers(), PHYX_FLOAT_ONE, PHYX_FLOAT_NULL);
+}
+
+PhyxUnit *PhyxUnitSystem::findUnit(const PhyxUnit *unit, bool baseUnit, PhyxFloatDataType scaleFactor, PhyxFloatDataType offset) const
+{
+    // the candidates share the hash of the powers, the first one that matches is the preferred unit
+    const PhyxUnitIndex &index = baseUnit ? baseUnitIndex : derivedUnitIndex;
+    PhyxUnitIndex::const_iterator it = index.constFind(unit->dimensionHash());
+    if (it == index.constEnd())
+        return NULL;
+
+    const QList<PhyxUnit*> &candidates = it.value();
+    for (int i = 0; i < candidates.size(); i++)
     {
-        QMapIterator<QString, PhyxUnit*> i(baseUnitsMap);
-        while (i.hasNext())
+        PhyxUnit *candidate = candidates.at(i);
+        if ((candidate->scaleFactor() == scaleFactor) && (candidate->offset() == offset) && candidate->powersCompare(unit))
+            return candidate;
+    }
+    return NULL;
+}
+
+void PhyxUnitSystem::share(const PhyxUnitSystem *base)
+{
+    //the containers are implicitly shared, the units themselves are never changed once they are in the system
+    baseUnitsMap = base->baseUnitsMap;
+    derivedUnitsMap = base->derivedUnitsMap;
+    prefixMap = base->prefixMap;
+    unitGroupsList = base->unitGroupsList;
+    baseUnitIndex = base->baseUnitIndex;
+    derivedUnitIndex = base->derivedUnitIndex;
+
+    sharedUnits = base->sharedUnits;
+    foreach (PhyxUnit *unit, baseUnitsMap)
+        sharedUnits.insert(unit);
+    foreach (PhyxUnit *unit, derivedUnitsMap)
+        sharedUnits.insert(unit);
+}
+
+void PhyxUnitSystem::swap(PhyxUnitSystem *other)
+{
+    qSwap(baseUnitsMap, other->baseUnitsMap);
+    qSwap(derivedUnitsMap, other->derivedUnitsMap);
+    qSwap(prefixMap, other->prefixMap);
+    qSwap(unitGroupsList, other->unitGroupsList);
+    qSwap(baseUnitIndex, other->baseUnitIndex);
+    qSwap(derivedUnitIndex, other->derivedUnitIndex);
+    qSwap(sharedUnits, other->sharedUnits);
+}
+
+void PhyxUnitSystem::releaseUnit(PhyxUnit *unit)
+{
+    if (!sharedUnits.contains(unit))
+        unit->deleteLater();
+}
+
+void PhyxUnitSystem::indexUnit(PhyxUnitIndex *index, PhyxUnit *unit)
+{
+    // units with a unit group are preferred, then units are ordered by symbol
+    QList<PhyxUnit*> &candidates = (*index)[unit->dimensionHash()];
+    int pos = 0;
+    while (pos < candidates.size())
+    {
+        PhyxUnit *candidate = candidates.at(pos);
+        if (candidate->unitGroup().isEmpty() != unit->unitGroup().isEmpty())
         {
-            i.next();
-            if (i.value()->isSame(unit))
-            {
-                //PhyxUnit::copyUnit(i.value(), unit);
-               // unit->deleteLater();
-                //unit = i.value();
-                return i.value();
-                //return true;
-            }
+            if (candidate->unitGroup().isEmpty())
+                break;
         }
+        else if (unit->symbol() < candidate->symbol())
+            break;
+        pos++;
     }
-    else
+    candidates.insert(pos, unit);
+}
+
+void PhyxUnitSystem::unindexUnit(PhyxUnitIndex *index, PhyxUnit *unit)
+{
+    uint hash = unit->dimensionHash();
+    PhyxUnitIndex::iterator it = index->find(hash);
+    if (it == index->end())
+        return;
+
+    it.value().removeOne(unit);
+    if (it.value().isEmpty())
+        index->erase(it);
+}
+
+void PhyxUnitSystem::save(QDataStream &stream) const
+{
+    stream << unitGroupsList;
+
+    // the multi map returns the most recently inserted prefix first, reverse to keep the order on reload
+    QList<PhyxPrefix> prefixList = prefixMap.values();
+    stream << static_cast<qint32>(prefixList.size());
+    for (int i = prefixList.size()-1; i >= 0; i--)
+    {
+        const PhyxPrefix &prefix = prefixList.at(i);
+        stream << prefix.symbol << prefix.unitGroup << prefix.inputOnly;
+        PhyxUnit::saveFloat(stream, prefix.value);
+    }
+
+    const PhyxUnitMap *maps[2] = {&baseUnitsMap, &derivedUnitsMap};
+    for (int m = 0; m < 2; m++)
     {
-        QList<PhyxUnit*> matchList;
-        QMapIterator<QString, PhyxUnit*> i(derivedUnitsMap);
+        stream << static_cast<qint32>(maps[m]->size());
+        QMapIterator<QString, PhyxUnit*> i(*maps[m]);
         while (i.hasNext())
         {
             i.next();
-            if (i.value()->isSame(unit))
-                matchList.append(i.value());
+            i.value()->save(stream);
         }
+    }
+}
+
+bool PhyxUnitSystem::load(QDataStream &stream)
+{
+    QStringList newUnitGroupsList;
+    QMultiMap<QString, PhyxPrefix> newPrefixMap;
+    PhyxUnitMap newUnitMaps[2];
+    qint32 count;
+
+    stream >> newUnitGroupsList;
+
+    stream >> count;
+    for (int i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++)
+    {
+        PhyxPrefix prefix;
+        stream >> prefix.symbol >> prefix.unitGroup >> prefix.inputOnly;
+        prefix.value = PhyxUnit::loadFloat(stream);
+        newPrefixMap.insert(prefix.symbol, prefix);
+    }
 
-        if (!matchList.isEmpty())
+    for (int m = 0; m < 2; m++)
+    {
+        stream >> count;
+        for (int i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++)
         {
-            PhyxUnit* match = NULL;
-            if (matchList.size() > 1)   //handle multiple matches, currently the first match with unitGroup is used
-            {
-                for (int pos = 0; pos < matchList.size(); pos++)
-                {
-                    if (!matchList.at(pos)->unitGroup().isEmpty())
-                    {
-                        match = matchList[pos];
-                        break;
-                    }
-                }
-                if (match == NULL)
-                    match = matchList.first();
-            }
-            else
-                match = matchList.first();
-
-            //PhyxUnit::copyUnit(match, unit);
-            //unit->deleteLater();
-            //unit = match;
-            return match;
-            //return true;
+            PhyxUnit *unit = new PhyxUnit();
+            unit->load(stream);
+            newUnitMaps[m].insert(unit->symbol(), unit);
         }
     }
 
-    return NULL;
-    //return false;
+    if (stream.status() != QDataStream::Ok)
+    {
+        for (int m = 0; m < 2; m++)
+            qDeleteAll(newUnitMaps[m]);
+        return false;
+    }
+
+    foreach (PhyxUnit *unit, baseUnitsMap)
+        releaseUnit(unit);
+    foreach (PhyxUnit *unit, derivedUnitsMap)
+        releaseUnit(unit);
+    sharedUnits.clear();
+    unitGroupsList = newUnitGroupsList;
+    prefixMap = newPrefixMap;
+    baseUnitsMap = newUnitMaps[0];
+    derivedUnitsMap = newUnitMaps[1];
+
+    baseUnitIndex.clear();
+    derivedUnitIndex.clear();
+    foreach (PhyxUnit *unit, baseUnitsMap)
+        indexUnit(&baseUnitIndex, unit);
+    foreach (PhyxUnit *unit, derivedUnitsMap)
+        indexUnit(&derivedUnitIndex, unit);
+
+    return true;
 }
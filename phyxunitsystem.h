@@ -21,6 +21,8 @@
 #define PHYXUNITSYSTEM_H
 
 #include <QObject>
+#include <QHash>
+#include <QSet>
 #include <QStringList>
 #include "phyxunit.h"
 #include "global.h"
@@ -42,6 +44,7 @@ public:
     } PhyxPrefix;
 
     typedef QMap<QString, PhyxUnit*> PhyxUnitMap;
+    typedef QHash<uint, QList<PhyxUnit*> > PhyxUnitIndex;
 
     explicit PhyxUnitSystem(QObject *parent = 0);
     ~PhyxUnitSystem();
@@ -60,17 +63,32 @@ public:
 
     PhyxUnit * copyUnit(QString symbol) const;                      ///< copys a unit
     PhyxUnit * unit(QString symbol) const;                          ///< gives back a reference to the unit
+    bool containsUnit(QString symbol) const;                        ///< returns wheter a unit with the symbol is defined
     PhyxUnitMap units() const;                                      ///< gives back a map holding all defined units
 
     PhyxPrefix  prefix(QString symbol, QString unitGroup) const;  ///< returns the value of a prefix
     QList<PhyxPrefix> prefixes(QString unitGroup = QString()) const;            ///< returns all prefixes for one unitGroup sorted
 
     PhyxUnit * verifyUnit(PhyxUnit *unit) const;                             ///< finds unit in the system and sets all the missing information, return wheter unit was found or not
+    PhyxUnit * verifyPowers(const PhyxUnit *unit) const;                     ///< finds the unit without scale factor and offset that has the powers of unit, NULL if there is none
+
+    void save(QDataStream &stream) const;                           ///< writes unit groups, prefixes and units to a snapshot stream
+    bool load(QDataStream &stream);                                 ///< replaces the system with the content of a snapshot stream without emitting signals, returns successful
+    void share(const PhyxUnitSystem *base);                         ///< replaces the system with the units of base without emitting signals, base must outlive this system
+    void swap(PhyxUnitSystem *other);                               ///< exchanges the content with other without emitting signals
 private:
     PhyxUnitMap    baseUnitsMap;                                    /// contains all base units mapped with their symbol
     PhyxUnitMap    derivedUnitsMap;                                 /// contains all derived units mapped with their symbol
     QMultiMap<QString, PhyxPrefix>   prefixMap;                     /// contains all unit prefixes
     QStringList                 unitGroupsList;                     /// contains all unit groups
+    PhyxUnitIndex               baseUnitIndex;                      /// base units by dimension hash, preferred units first
+    PhyxUnitIndex               derivedUnitIndex;                   /// derived units by dimension hash, preferred units first
+    QSet<PhyxUnit*>             sharedUnits;                        /// units owned by the system this one was shared from, they are never deleted here
+
+    void releaseUnit(PhyxUnit *unit);                               ///< deletes a unit that left the system unless it is shared
+    void indexUnit(PhyxUnitIndex *index, PhyxUnit *unit);           ///< adds a unit to a dimension index
+    void unindexUnit(PhyxUnitIndex *index, PhyxUnit *unit);         ///< removes a unit from a dimension index
+    PhyxUnit * findUnit(const PhyxUnit *unit, bool baseUnit, PhyxFloatDataType scaleFactor, PhyxFloatDataType offset) const;   ///< looks up the preferred unit with the powers of unit and the given scale factor and offset
 
     void recalculateUnits();                                        ///< recalculates all units
     void recalculateVariables();                                    ///< recalculates all variables
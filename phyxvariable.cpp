@@ -23,7 +23,13 @@ PhyxVariable::PhyxVariable(QObject *parent) :
     QObject(parent)
 {
     m_value = 1;
+    m_valueType = IntegerValue;
+    m_integerValue = 1;
     m_unit = new PhyxCompoundUnit();
+    connect(m_unit, SIGNAL(offsetValue(PhyxFloatDataType)),
+            this, SLOT(offsetValue(PhyxFloatDataType)));
+    connect(m_unit, SIGNAL(scaleValue(PhyxFloatDataType)),
+            this, SLOT(scaleValue(PhyxFloatDataType)));
 }
 
 PhyxVariable::~PhyxVariable()
@@ -41,34 +47,52 @@ void PhyxVariable::copyVariable(PhyxVariable *source, PhyxVariable *destination)
     //PhyxCompoundUnit *unit = new PhyxCompoundUnit();
     PhyxCompoundUnit::copyCompoundUnit(source->unit(), destination->unit());
     //destination->setUnit(unit);
-    destination->setValue(source->value());
+    destination->m_value = source->m_value;
+    destination->m_valueType = source->m_valueType;
+    destination->m_integerValue = source->m_integerValue;
+}
+
+void PhyxVariable::save(QDataStream &stream) const
+{
+    PhyxUnit::saveFloat(stream, m_value.real());
+    PhyxUnit::saveFloat(stream, m_value.imag());
+    m_unit->save(stream);
+}
+
+void PhyxVariable::load(QDataStream &stream, PhyxUnitSystem *unitSystem)
+{
+    PhyxFloatDataType real = PhyxUnit::loadFloat(stream);
+    PhyxFloatDataType imag = PhyxUnit::loadFloat(stream);
+    setValue(PhyxValueDataType(real, imag));
+    m_unit->setUnitSystem(unitSystem);
+    m_unit->load(stream);
 }
 
 void PhyxVariable::setUnit(PhyxUnit *unit)
 {
-    m_unit->fromSimpleUnit(unit);
-    connect(m_unit, SIGNAL(offsetValue(PhyxFloatDataType)),
-            this, SLOT(offsetValue(PhyxFloatDataType)));
-    connect(m_unit, SIGNAL(scaleValue(PhyxFloatDataType)),
-            this, SLOT(scaleValue(PhyxFloatDataType)));
+    m_unit->fromSimpleUnit(unit);   //the unit is connected since construction
 }
 
-bool PhyxVariable::isComplex()
+bool PhyxVariable::isComplex() const
 {
-    return (m_value.imag() != PHYX_FLOAT_NULL);
+    return (m_valueType == ComplexValue);
 }
 
-bool PhyxVariable::isPositive()
+bool PhyxVariable::isPositive() const
 {
     return (m_value.real() >= PHYX_FLOAT_NULL);
 }
 
-bool PhyxVariable::isInteger()
+bool PhyxVariable::isInteger() const
 {
+    if (m_valueType == IntegerValue)
+        return true;
     return (!this->isComplex() && (static_cast<PhyxFloatDataType>(this->toInt()) == m_value.real()));
 }
 
-PhyxIntegerDataType PhyxVariable::toInt()
+PhyxIntegerDataType PhyxVariable::toInt() const
 {
+    if (m_valueType == IntegerValue)
+        return m_integerValue;
     return static_cast<PhyxIntegerDataType>(m_value.real());
 }
@@ -36,21 +36,42 @@ class PhyxVariable : public QObject
     Q_PROPERTY(PhyxCompoundUnit *unit READ unit WRITE setUnit)
 
 public:
+    enum ValueType {
+        IntegerValue,       ///< real value that holds an exact integer
+        RealValue,          ///< real value
+        ComplexValue        ///< value with an imaginary part
+    };
+
     explicit PhyxVariable(QObject *parent = 0);
     ~PhyxVariable();
 
     bool convertUnit(PhyxCompoundUnit *unit);
     static void copyVariable(PhyxVariable *source, PhyxVariable *destination);
 
-    bool isComplex();
-    bool isPositive();
-    bool isInteger();
-    PhyxIntegerDataType toInt();
+    void save(QDataStream &stream) const;                               ///< writes value and unit to a snapshot stream
+    void load(QDataStream &stream, PhyxUnitSystem *unitSystem);         ///< reads value and unit from a snapshot stream
+
+    bool isComplex() const;
+    bool isPositive() const;
+    bool isInteger() const;
+    PhyxIntegerDataType toInt() const;
 
     PhyxValueDataType value() const
     {
         return m_value;
     }
+    PhyxFloatDataType realValue() const
+    {
+        return m_value.real();
+    }
+    ValueType valueType() const
+    {
+        return m_valueType;
+    }
+    bool isReal() const
+    {
+        return (m_valueType != ComplexValue);
+    }
     PhyxCompoundUnit * unit() const
     {
         return m_unit;
@@ -58,6 +79,8 @@ public:
 
 private:
     PhyxValueDataType   m_value;
+    ValueType           m_valueType;        ///< tells the calculator which kernels can be used for the value
+    PhyxIntegerDataType m_integerValue;     ///< exact value if the value type is IntegerValue
     PhyxCompoundUnit    *m_unit;
 
 signals:
@@ -67,6 +90,18 @@ public slots:
 void setValue(PhyxValueDataType arg)
 {
     m_value = arg;
+    m_valueType = (arg.imag() != PHYX_FLOAT_NULL) ? ComplexValue : RealValue;
+}
+void setRealValue(PhyxFloatDataType arg)
+{
+    m_value = PhyxValueDataType(arg, PHYX_FLOAT_NULL);
+    m_valueType = RealValue;
+}
+void setIntegerValue(PhyxIntegerDataType arg)
+{
+    m_value = PhyxValueDataType(static_cast<PhyxFloatDataType>(arg), PHYX_FLOAT_NULL);
+    m_valueType = IntegerValue;
+    m_integerValue = arg;
 }
 void setUnit(PhyxCompoundUnit * arg)
 {
@@ -82,10 +117,13 @@ void setUnit(PhyxUnit *unit);
 void offsetValue(PhyxFloatDataType offset)
 {
     m_value += offset;
+    if (m_valueType == IntegerValue)
+        m_valueType = RealValue;
 }
 void scaleValue(PhyxFloatDataType scaleFactor)
 {
     m_value *= scaleFactor;
+    m_valueType = (m_value.imag() != PHYX_FLOAT_NULL) ? ComplexValue : RealValue;
 }
 };
 
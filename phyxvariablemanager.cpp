@@ -24,10 +24,23 @@ PhyxVariableManager::PhyxVariableManager(QObject *parent) :
 {
 }
 
+PhyxVariableManager::~PhyxVariableManager()
+{
+    foreach (PhyxVariable *variable, variableMap)
+        releaseVariable(variable);
+    foreach (PhyxVariable *variable, constantMap)
+        releaseVariable(variable);
+    foreach (PhyxFunction *function, functionMap)
+    {
+        if (!sharedFunctions.contains(function))
+            delete function;
+    }
+}
+
 void PhyxVariableManager::addVariable(QString name, PhyxVariable *variable)
 {
     if (variableMap.contains(name))
-        variableMap.value(name)->deleteLater();
+        releaseVariable(variableMap.value(name));
 
     variableMap.insert(name, variable);
     emit variableAdded(name);
@@ -49,12 +62,22 @@ void PhyxVariableManager::removeVariable(QString name)
 {
     if (variableMap.contains(name))
     {
-        variableMap.value(name)->deleteLater();
+        releaseVariable(variableMap.value(name));
         variableMap.remove(name);
         emit variableRemoved(name);
     }
 }
 
+PhyxVariable *PhyxVariableManager::takeVariable(QString name)
+{
+    PhyxVariable *variable = variableMap.value(name, NULL);
+    if ((variable == NULL) || sharedVariables.contains(variable))
+        return NULL;
+
+    variableMap.remove(name);
+    return variable;
+}
+
 void PhyxVariableManager::renameVariable(QString oldName, QString newName)
 {
     if (variableMap.contains(oldName))
@@ -80,7 +103,7 @@ PhyxVariableManager::PhyxVariableMap *PhyxVariableManager::variables()
 void PhyxVariableManager::addConstant(QString name, PhyxVariable *variable)
 {
     if (constantMap.contains(name))
-        constantMap.value(name)->deleteLater();
+        releaseVariable(constantMap.value(name));
 
     constantMap.insert(name, variable);
     emit constantAdded(name);
@@ -102,7 +125,7 @@ void PhyxVariableManager::removeConstant(QString name)
 {
     if (constantMap.contains(name))
     {
-        constantMap.value(name)->deleteLater();
+        releaseVariable(constantMap.value(name));
         constantMap.remove(name);
         emit constantRemoved(name);
     }
@@ -172,6 +195,30 @@ void PhyxVariableManager::addDataset(PhyxVariableManager::PhyxDataset *dataset)
     datasetList.append(dataset);
 }
 
+PhyxVariableManager::PhyxDatasetColumn PhyxVariableManager::datasetColumn(const QVector<PhyxValueDataType> &values)
+{
+    PhyxDatasetColumn column;
+    bool complex = false;
+
+    column.real.resize(values.size());
+    for (int i = 0; i < values.size(); i++)
+    {
+        column.real[i] = values.at(i).real();
+        if (values.at(i).imag() != PHYX_FLOAT_NULL)
+            complex = true;
+    }
+
+    //imaginary parts are only stored if needed
+    if (complex)
+    {
+        column.imag.resize(values.size());
+        for (int i = 0; i < values.size(); i++)
+            column.imag[i] = values.at(i).imag();
+    }
+
+    return column;
+}
+
 PhyxVariableManager::PhyxDataset *PhyxVariableManager::getDataset(int index) const
 {
     if (index < datasetList.size())
@@ -194,6 +241,84 @@ PhyxVariableManager::PhyxDatasetList *PhyxVariableManager::datasets()
     return &datasetList;
 }
 
+void PhyxVariableManager::save(QDataStream &stream) const
+{
+    const PhyxVariableMap *maps[2] = {&variableMap, &constantMap};
+    for (int m = 0; m < 2; m++)
+    {
+        stream << static_cast<qint32>(maps[m]->size());
+        QMapIterator<QString, PhyxVariable*> i(*maps[m]);
+        while (i.hasNext())
+        {
+            i.next();
+            stream << i.key();
+            i.value()->save(stream);
+        }
+    }
+
+    stream << static_cast<qint32>(functionMap.size());
+    QMapIterator<QString, PhyxFunction*> i(functionMap);
+    while (i.hasNext())
+    {
+        i.next();
+        stream << i.key() << i.value()->expression << i.value()->parameters;
+    }
+}
+
+bool PhyxVariableManager::load(QDataStream &stream, PhyxUnitSystem *unitSystem)
+{
+    PhyxVariableMap newMaps[2];
+    PhyxFunctionMap newFunctionMap;
+    qint32 count;
+
+    for (int m = 0; m < 2; m++)
+    {
+        stream >> count;
+        for (int i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++)
+        {
+            QString name;
+            PhyxVariable *variable = new PhyxVariable();
+            stream >> name;
+            variable->load(stream, unitSystem);
+            newMaps[m].insert(name, variable);
+        }
+    }
+
+    stream >> count;
+    for (int i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++)
+    {
+        QString name;
+        PhyxFunction *function = new PhyxFunction();
+        stream >> name >> function->expression >> function->parameters;
+        newFunctionMap.insert(name, function);
+    }
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        for (int m = 0; m < 2; m++)
+            qDeleteAll(newMaps[m]);
+        qDeleteAll(newFunctionMap);
+        return false;
+    }
+
+    foreach (PhyxVariable *variable, variableMap)
+        releaseVariable(variable);
+    foreach (PhyxVariable *variable, constantMap)
+        releaseVariable(variable);
+    foreach (PhyxFunction *function, functionMap)
+    {
+        if (!sharedFunctions.contains(function))
+            delete function;
+    }
+    sharedVariables.clear();
+    sharedFunctions.clear();
+    variableMap = newMaps[0];
+    constantMap = newMaps[1];
+    functionMap = newFunctionMap;
+
+    return true;
+}
+
 void PhyxVariableManager::clearVariables()
 {
     QMapIterator<QString, PhyxVariable*> i(variableMap);
@@ -205,6 +330,38 @@ void PhyxVariableManager::clearVariables()
 
         variableMap.remove(name);
         emit variableRemoved(name);
-        variable->deleteLater();
+        releaseVariable(variable);
     }
 }
+
+void PhyxVariableManager::share(const PhyxVariableManager *base)
+{
+    //the maps are implicitly shared, stored variables and functions are replaced instead of changed
+    variableMap = base->variableMap;
+    constantMap = base->constantMap;
+    functionMap = base->functionMap;
+
+    sharedVariables = base->sharedVariables;
+    foreach (PhyxVariable *variable, variableMap)
+        sharedVariables.insert(variable);
+    foreach (PhyxVariable *variable, constantMap)
+        sharedVariables.insert(variable);
+    sharedFunctions = base->sharedFunctions;
+    foreach (PhyxFunction *function, functionMap)
+        sharedFunctions.insert(function);
+}
+
+void PhyxVariableManager::swap(PhyxVariableManager *other)
+{
+    qSwap(variableMap, other->variableMap);
+    qSwap(constantMap, other->constantMap);
+    qSwap(functionMap, other->functionMap);
+    qSwap(sharedVariables, other->sharedVariables);
+    qSwap(sharedFunctions, other->sharedFunctions);
+}
+
+void PhyxVariableManager::releaseVariable(PhyxVariable *variable)
+{
+    if (!sharedVariables.contains(variable))
+        variable->deleteLater();
+}
@@ -21,6 +21,8 @@
 #define PHYXVARIABLEMANAGER_H
 
 #include <QObject>
+#include <QVector>
+#include <QSet>
 #include "phyxvariable.h"
 
 class PhyxVariableManager : public QObject
@@ -42,10 +44,29 @@ public:
         LogarithmicDataset
     };
 
+    typedef struct {
+        QVector<PhyxFloatDataType> real;        /// real parts of the samples
+        QVector<PhyxFloatDataType> imag;        /// imaginary parts of the samples, empty if all samples are real
+        QVector<double> doubleReal;             /// real parts in double precision, filled on first use by doubleValues()
+
+        int size() const { return real.size(); }
+        PhyxValueDataType at(int i) const { return PhyxValueDataType(real.at(i), imag.isEmpty() ? PHYX_FLOAT_NULL : imag.at(i)); }
+        const QVector<double> & doubleValues()
+        {
+            if (doubleReal.size() != real.size())
+            {
+                doubleReal.resize(real.size());
+                for (int i = 0; i < real.size(); i++)
+                    doubleReal[i] = static_cast<double>(real.at(i));
+            }
+            return doubleReal;
+        }
+    } PhyxDatasetColumn;
+
     typedef struct {
         QString name;
         QList<PhyxCompoundUnit*> unit;
-        QList<QList<PhyxValueDataType> > data;
+        QList<PhyxDatasetColumn> data;
         bool plotted;
         int plotXAxis;
         int plotYAxis;
@@ -54,10 +75,12 @@ public:
     typedef QList<PhyxDataset*> PhyxDatasetList;
 
     explicit PhyxVariableManager(QObject *parent = 0);
+    ~PhyxVariableManager();
 
     void addVariable(QString name, PhyxVariable *variable);
     PhyxVariable * getVariable(QString name) const;
     void removeVariable(QString name);
+    PhyxVariable * takeVariable(QString name);                          ///< removes a variable without signals and hands it to the caller, NULL if it is unknown or shared
     void renameVariable(QString oldName, QString newName);
     bool containsVariable(QString name) const;
     PhyxVariableMap * variables();
@@ -72,15 +95,25 @@ public:
     void removeFunction(QString name);
     PhyxFunctionMap * functions();
     void addDataset(PhyxDataset* dataset);
+    static PhyxDatasetColumn datasetColumn(const QVector<PhyxValueDataType> &values);   ///< stores values as a dataset column
     PhyxDataset * getDataset(int index) const;
     void removeDataset(int index);
     PhyxDatasetList * datasets();
 
+    void save(QDataStream &stream) const;                               ///< writes variables, constants and functions to a snapshot stream
+    bool load(QDataStream &stream, PhyxUnitSystem *unitSystem);         ///< replaces variables, constants and functions with the content of a snapshot stream without emitting signals, returns successful
+    void share(const PhyxVariableManager *base);                        ///< replaces variables, constants and functions with the ones of base without emitting signals, base must outlive this manager
+    void swap(PhyxVariableManager *other);                              ///< exchanges variables, constants and functions with other without emitting signals
+
 private:
     PhyxVariableMap variableMap;
     PhyxVariableMap constantMap;
     PhyxFunctionMap functionMap;
     PhyxDatasetList datasetList;
+    QSet<PhyxVariable*> sharedVariables;                                /// variables owned by the manager this one was shared from, they are never deleted here
+    QSet<PhyxFunction*> sharedFunctions;                                /// functions owned by the manager this one was shared from
+
+    void releaseVariable(PhyxVariable *variable);                       ///< deletes a variable that left the manager unless it is shared
     
 signals:
     void variableAdded(QString name);
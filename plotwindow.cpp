@@ -438,15 +438,9 @@ void PlotWindow::plotDataset(int index, int xAxis, int yAxis)
 
     PhyxVariableManager::PhyxDataset *dataset = (*m_datasets)[index];
 
-    //convert data
-    QVector<double> x;
-    QVector<double> y;
-
-    for (int i = 0; i < dataset->data.at(0).size(); i++)
-    {
-        x.append(static_cast<PhyxFloatDataType>(dataset->data.at(0).at(i).real()));
-        y.append(static_cast<PhyxFloatDataType>(dataset->data.at(1).at(i).real()));
-    }
+    //the double values are shared with the dataset, they are only converted on the first plot
+    QVector<double> x = dataset->data[0].doubleValues();
+    QVector<double> y = dataset->data[1].doubleValues();
 
     QwtPlotCurve *plotCurve = new QwtPlotCurve(dataset->name);
     plotCurve->setRenderHint(QwtPlotItem::RenderAntialiased);
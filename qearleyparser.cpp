@@ -19,83 +19,272 @@
 
 #include "qearleyparser.h"
 
-QEarleyParser::QEarleyParser(QObject *parent) :
-    QObject(parent)
+EarleyItemArena::EarleyItemArena()
 {
-    isRecursionDone = false;
+    chunkIndex = 0;
+    used = 0;
 }
 
-bool QEarleyParser::loadRule(QString rule, QStringList functions)
+EarleyItemArena::~EarleyItemArena()
 {
-    //fixing the nonTerminal 0 problem, 0 is already a terminal
-    if (nonTerminals.isEmpty())
+    for (int i = 0; i < chunks.size(); i++)
+        delete[] chunks.at(i);
+}
+
+EarleyItem *EarleyItemArena::allocate()
+{
+    if (used == (FirstChunkSize << chunkIndex))
     {
-        nonTerminals.append(QString());
-        rules.append(QList<EarleyRule>());
-        isNullableVector.append(false);
+        chunkIndex++;
+        used = 0;
     }
+    if (chunkIndex == chunks.size())
+        chunks.append(new EarleyItem[FirstChunkSize << chunkIndex]);
 
-    int equalPos = rule.indexOf('=');
-    if (equalPos == -1)
+    return &chunks.at(chunkIndex)[used++];
+}
+
+void EarleyItemSet::clear()
+{
+    arena.reset();
+    items.resize(0);
+    hashTable.fill(-1);
+    symbolSlots.resize(0);
+    symbolTable.fill(-1);
+    packedNodes.resize(0);
+}
+
+bool EarleyItemSet::append(const EarleyItem &item, int *index)
+{
+    if (((items.size() + 1) * 2) > hashTable.size())   //keep the load factor below 0.5
+        rehash(qMax(16, hashTable.size() * 2));
+
+    int slot = find(item);
+    *index = hashTable.at(slot);
+    if (*index != -1)
+        return false;
+
+    EarleyItem *newItem = arena.allocate();
+    *newItem = item;
+    newItem->nextWaiting = -1;
+
+    *index = items.size();
+    hashTable[slot] = items.size();
+    grow(items);
+    items.append(newItem);
+
+    if ((item.dotPos < item.rule->conclusion.size()) && (item.rule->conclusion.at(item.dotPos) < 0))
     {
-        qDebug() << "Not a valid rule";
+        //index for the completer, the waiting items of a symbol are linked in insertion order
+        EarleySymbolSlot *symbol = symbolSlot(item.rule->conclusion.at(item.dotPos), true);
+        if (symbol->firstWaiting == -1)
+            symbol->firstWaiting = *index;
+        else
+            items[symbol->lastWaiting]->nextWaiting = *index;
+        symbol->lastWaiting = *index;
+    }
+
+    return true;
+}
+
+void EarleyItemSet::appendPackedNode(const EarleyPackedNode &packedNode)
+{
+    grow(packedNodes);
+    packedNodes.append(packedNode);
+}
+
+EarleyItem *EarleyItemSet::firstWaitingItem(EarleySymbol symbol)
+{
+    EarleySymbolSlot *slot = symbolSlot(symbol, false);
+    if ((slot == NULL) || (slot->firstWaiting == -1))
+        return NULL;
+    return items[slot->firstWaiting];
+}
+
+EarleyItem *EarleyItemSet::nextWaitingItem(const EarleyItem *item)
+{
+    if (item->nextWaiting == -1)
+        return NULL;
+    return items[item->nextWaiting];
+}
+
+bool EarleyItemSet::markPredicted(EarleySymbol symbol)
+{
+    EarleySymbolSlot *slot = symbolSlot(symbol, true);
+    if (slot->predicted)
         return false;
+    slot->predicted = true;
+    return true;
+}
+
+bool EarleyItemSet::leoItem(EarleySymbol symbol, EarleyLeoItem *leo)
+{
+    EarleySymbolSlot *slot = symbolSlot(symbol, false);
+    if ((slot == NULL) || !slot->hasLeoItem)
+        return false;
+    *leo = slot->leoItem;
+    return true;
+}
+
+void EarleyItemSet::setLeoItem(EarleySymbol symbol, const EarleyLeoItem &leo)
+{
+    EarleySymbolSlot *slot = symbolSlot(symbol, true);
+    slot->hasLeoItem = true;
+    slot->leoItem = leo;
+}
+
+uint EarleyItemSet::hash(const EarleyItem &item)
+{
+    quintptr rule = reinterpret_cast<quintptr>(item.rule);
+    uint h = uint(rule >> 3) ^ uint(quint64(rule) >> 32);
+    h = (h * 31u) + uint(item.dotPos);
+    h = (h * 31u) + uint(item.startPos);
+    h = (h * 31u) + uint(item.lexState);
+    return h ^ (h >> 16);
+}
+
+int EarleyItemSet::find(const EarleyItem &item) const
+{
+    const int mask = hashTable.size() - 1;     //capacity is always a power of two
+    int slot = hash(item) & mask;
+
+    forever
+    {
+        int index = hashTable.at(slot);
+        if ((index == -1) || (*items.at(index) == item))
+            return slot;
+        slot = (slot + 1) & mask;
     }
+}
 
-    //split premise and conclusio
-    QString premise = rule.left(equalPos);
-    QString conclusio = rule.mid(equalPos+1);
+void EarleyItemSet::rehash(int capacity)
+{
+    if (capacity > hashTable.capacity())
+        allocations++;
+    hashTable.fill(-1, capacity);
+    for (int i = 0; i < items.size(); i++)
+        hashTable[find(*items.at(i))] = i;
+}
 
-    EarleyRule newRule;
+EarleySymbolSlot *EarleyItemSet::symbolSlot(EarleySymbol symbol, bool create)
+{
+    if (symbolTable.isEmpty())
+    {
+        if (!create)
+            return NULL;
+        allocations++;
+        symbolTable.fill(-1, 16);
+    }
 
-    newRule.premise = addNonTerminal(premise);         //convert premise
+    int mask = symbolTable.size() - 1;        //capacity is always a power of two
+    int slot = uint(-symbol * 31) & mask;
+    forever
+    {
+        int index = symbolTable.at(slot);
+        if (index == -1)
+            break;
+        if (symbolSlots.at(index).symbol == symbol)
+            return &symbolSlots[index];
+        slot = (slot + 1) & mask;
+    }
 
-    //replace the any+ char \* -> unicode 127 DEL
-    conclusio.replace("\\*",QChar(127));
-    //replace the any char \~ -> unicode 27 ESC
-    conclusio.replace("\\~",QChar(27));
-    //replace the any char \+ -> unicode 26 SUB
-    conclusio.replace("\\+",QChar(26));
+    if (!create)
+        return NULL;
+
+    EarleySymbolSlot newSlot;
+    newSlot.symbol = symbol;
+    newSlot.firstWaiting = -1;
+    newSlot.lastWaiting = -1;
+    newSlot.predicted = false;
+    newSlot.hasLeoItem = false;
+    newSlot.leoItem.rule = NULL;
+    newSlot.leoItem.startPos = 0;
+    grow(symbolSlots);
+    symbolSlots.append(newSlot);
 
-    //convert conclusio
-    if (!conclusio.isEmpty())   //check for epsilon rule
+    if ((symbolSlots.size() * 2) > symbolTable.size())     //keep the load factor below 0.5
     {
-        bool isNonTerminal = false;
-        int nonTerminalPos = 0;
-        for (int i = 0; i < conclusio.size(); i++)
+        if ((symbolTable.size() * 2) > symbolTable.capacity())
+            allocations++;
+        symbolTable.fill(-1, symbolTable.size() * 2);
+        mask = symbolTable.size() - 1;
+        for (int i = 0; i < symbolSlots.size(); i++)
         {
-            if (conclusio.at(i) == '|')
-            {
-                if ((i > 0) && (conclusio.at(i-1) == '\\')) //terminated |
-                {
-                    newRule.conclusion.remove(newRule.conclusion.size()-1);
-                    newRule.conclusion.append(conclusio.at(i).unicode());
-                }
-                else
-                {
-                    if (!isNonTerminal)
-                        nonTerminalPos = i+1;
-                    else
-                    {
-                        QString tmpNonTerminal = conclusio.mid(nonTerminalPos, i-nonTerminalPos);
-                        newRule.conclusion.append(addNonTerminal(tmpNonTerminal));
-                    }
-                    isNonTerminal = !isNonTerminal;
-                }
-            }
-            else if (!isNonTerminal)
-            {
-                newRule.conclusion.append(conclusio.at(i).unicode());
-            }
+            slot = uint(-symbolSlots.at(i).symbol * 31) & mask;
+            while (symbolTable.at(slot) != -1)
+                slot = (slot + 1) & mask;
+            symbolTable[slot] = i;
         }
     }
     else
     {
-        isNullableVector[-newRule.premise] = true;     //if epsilon rule, nonTerminal is nullable
+        symbolTable[slot] = symbolSlots.size() - 1;
     }
 
+    return &symbolSlots.last();
+}
+
+quint8 QEarleyParser::terminalClasses[65536];
+quint8 QEarleyParser::characterClasses[65536];
+
+QEarleyParser::QEarleyParser(QObject *parent) :
+    QObject(parent)
+{
+    isNullableDirty = false;
+    itemListCount = 0;
+    lexiconChangePosition = -1;
+    setAllocations = 0;
+    ruleCounter = 0;
+    m_disambiguationPolicy = FirstDerivation;
+}
+
+QEarleyParser::~QEarleyParser()
+{
+    qDeleteAll(earleyItemLists);
+}
+
+bool QEarleyParser::loadRule(QString rule, QStringList functions)
+{
+    int equalPos = rule.indexOf('=');
+    if (equalPos == -1)
+    {
+        qDebug() << "Not a valid rule";
+        return false;
+    }
+
+    QVector<EarleySymbol> conclusion;
+    EarleySymbol premise = addNonTerminal(rule.left(equalPos));     //convert premise
+    convertConclusion(rule.mid(equalPos+1), &conclusion, true);     //convert conclusio
+
+    return loadRule(premise, conclusion, functions);
+}
+
+bool QEarleyParser::loadRule(EarleySymbol premise, const QVector<EarleySymbol> &conclusion, QStringList functions)
+{
+    if ((premise >= 0) || (-premise >= nonTerminals.size()))
+    {
+        qDebug() << "unknown nonTerminal";
+        return false;
+    }
+
+    QByteArray key = ruleKey(premise, conclusion);
+    if (ruleIndex.contains(key))    //rule is already active
+        return true;
+
+    EarleyRule newRule;
+    newRule.premise = premise;
+    newRule.conclusion = conclusion;
     newRule.functions = functions;
-    rules[-newRule.premise].append(newRule);
+    newRule.actions = resolveActions(functions);
+    newRule.removed = false;
+    newRule.order = ruleCounter++;
+
+    if (conclusion.isEmpty())
+        isNullableVector[-premise] = true;     //if epsilon rule, nonTerminal is nullable
+
+    ruleIndex.insert(key, rules.at(-premise).size());
+    rules[-premise].append(newRule);
+    isNullableDirty = true;
 
     itemListCount = 0;   //when a rule is changed, whole parsing needs to be done again
 
@@ -111,97 +300,231 @@ bool QEarleyParser::removeRule(QString rule)
         return false;
     }
 
-    //split premise and conclusio
-    QString premise = rule.left(equalPos);
-    QString conclusio = rule.mid(equalPos+1);
+    QVector<EarleySymbol> conclusion;
+    EarleySymbol premise = nonTerminalSymbol(rule.left(equalPos));     //find premise
+    if ((premise == 0) || !convertConclusion(rule.mid(equalPos+1), &conclusion, false))
+    {
+        qDebug() << "unknown rule";
+        return false;
+    }
 
-    EarleyRule newRule;
+    return removeRule(premise, conclusion);
+}
 
-    newRule.premise = -nonTerminals.indexOf(premise);      //find premise
-    if (newRule.premise == 1)
+bool QEarleyParser::removeRule(EarleySymbol premise, const QVector<EarleySymbol> &conclusion)
+{
+    QHash<QByteArray, int>::iterator indexIterator = ruleIndex.find(ruleKey(premise, conclusion));
+    if (indexIterator == ruleIndex.end())
     {
         qDebug() << "unknown rule";
         return false;
     }
+    int position = indexIterator.value();
+    ruleIndex.erase(indexIterator);
+
+    //the rule stays as tombstone so the positions of the other rules do not change
+    rules[-premise][position].removed = true;
+    removedRuleCount[-premise]++;
+    if (removedRuleCount.at(-premise) * 2 > rules.at(-premise).size())
+        compactRules(-premise);
+
+    isNullableDirty = true;
+    itemListCount = 0;   //when a rule is changed, whole parsing needs to be done again
+
+    return true;
+}
+
+EarleySymbol QEarleyParser::nonTerminalSymbol(QString name) const
+{
+    return -nonTerminalIds.value(name, 0);
+}
+
+QString QEarleyParser::nonTerminalName(EarleySymbol symbol) const
+{
+    if ((symbol >= 0) || (-symbol >= nonTerminals.size()))
+        return QString();
+    return nonTerminals.at(-symbol);
+}
+
+EarleySymbol QEarleyParser::addLexicon(QString name)
+{
+    EarleySymbol symbol = lexiconSymbol(name);
+    if (symbol != 0)
+        return symbol;
+
+    EarleyLexicon lexicon;
+    lexicon.name = name;
+    lexicon.nodes.append(EarleyLexiconNode());
+    lexicon.nodes[0].isWord = false;
+    lexicons.append(lexicon);
 
+    return LEXICON_SYMBOL_BASE + lexicons.size() - 1;
+}
+
+EarleySymbol QEarleyParser::lexiconSymbol(QString name) const
+{
+    for (int i = 0; i < lexicons.size(); i++)   //there are only a few lexicons
+    {
+        if (lexicons.at(i).name == name)
+            return LEXICON_SYMBOL_BASE + i;
+    }
+    return 0;
+}
+
+bool QEarleyParser::addLexiconWord(EarleySymbol lexicon, QString word)
+{
+    int index = lexicon - LEXICON_SYMBOL_BASE;
+    if ((index < 0) || (index >= lexicons.size()) || word.isEmpty())
+    {
+        qDebug() << "unknown lexicon";
+        return false;
+    }
+
+    if (lexicons.at(index).words.contains(word))    //checked before lexicons is detached from a shared grammar
+        return true;
+
+    EarleyLexicon &lexiconRef = lexicons[index];
+
+    int node = 0;
+    int pathLength = 0;     //characters of the word that were already in the trie
+    foreach (QChar character, word)
+    {
+        int next = lexiconRef.nodes.at(node).children.value(character.unicode(), 0);
+        if (next == 0)
+        {
+            next = lexiconRef.nodes.size();
+            lexiconRef.nodes.append(EarleyLexiconNode());
+            lexiconRef.nodes[next].isWord = false;
+            lexiconRef.nodes[node].children.insert(character.unicode(), next);
+        }
+        else
+            pathLength++;
+        node = next;
+    }
+    lexiconRef.nodes[node].isWord = true;
+    lexiconRef.words.insert(word);
+
+    invalidateLexiconWord(word, pathLength);
+
+    return true;
+}
+
+bool QEarleyParser::removeLexiconWord(EarleySymbol lexicon, QString word)
+{
+    int index = lexicon - LEXICON_SYMBOL_BASE;
+    if ((index < 0) || (index >= lexicons.size()) || !lexicons.at(index).words.contains(word))
+    {
+        qDebug() << "unknown word";
+        return false;
+    }
+
+    //the nodes stay, a node without word and children only ends the scan of a token
+    EarleyLexicon &lexiconRef = lexicons[index];
+    int node = 0;
+    foreach (QChar character, word)
+        node = lexiconRef.nodes.at(node).children.value(character.unicode());
+    lexiconRef.nodes[node].isWord = false;
+    lexiconRef.words.remove(word);
+
+    invalidateLexiconWord(word, word.size());
+
+    return true;
+}
+
+void QEarleyParser::invalidateLexiconWord(const QString &lexiconWord, int pathLength)
+{
+    if (itemListCount == 0)     //everything is parsed again anyway
+        return;
+
+    // only the trie node reached after pathLength characters changed, it got a new child or its word end
+    // changed, so a scan differs only where the word contains these characters and the following one,
+    // or where the word ends right at the changed node and the last set looks ahead into it
+    int matchLength = qMin(pathLength + 1, lexiconWord.size());
+    for (int start = 0; start + qMax(pathLength, 1) <= word.conclusion.size(); start++)
+    {
+        int length = qMin(matchLength, word.conclusion.size() - start);
+        int i = 0;
+        while ((i < length) && (word.conclusion.at(start + i) == lexiconWord.at(i).unicode()))
+            i++;
+
+        if ((i == matchLength) || ((start + i == word.conclusion.size()) && (i >= pathLength)))
+        {
+            //the set scanning into the changed node is the first one that differs
+            int position = start + qMax(pathLength - 1, 0);
+            if ((lexiconChangePosition == -1) || (position < lexiconChangePosition))
+                lexiconChangePosition = position;
+            return;
+        }
+    }
+}
+
+bool QEarleyParser::convertConclusion(QString conclusio, QVector<EarleySymbol> *conclusion, bool addUnknown)
+{
     //replace the any+ char \* -> unicode 127 DEL
-    conclusio.replace("\\*",QChar(127));
+    conclusio.replace("\\*",QChar(ANY_CHAR));
     //replace the any char \~ -> unicode 27 ESC
-    conclusio.replace("\\~",QChar(27));
+    conclusio.replace("\\~",QChar(ANY_CHAR_EXCEPT_EXCLUDED));
     //replace the any char \+ -> unicode 26 SUB
-    conclusio.replace("\\+",QChar(26));
+    conclusio.replace("\\+",QChar(ANY_CHAR_EXCEPT_EQUAL));
 
-    //convert conclusio
-    if (!conclusio.isEmpty())   //check for epsilon rule
+    bool isNonTerminal = false;
+    int nonTerminalPos = 0;
+    for (int i = 0; i < conclusio.size(); i++)     //an empty conclusio is an epsilon rule
     {
-        bool isNonTerminal = false;
-        int nonTerminalPos = 0;
-        for (int i = 0; i < conclusio.size(); i++)
+        if (conclusio.at(i) == '|')
         {
-            if (conclusio.at(i) == '|')
+            if ((i > 0) && (conclusio.at(i-1) == '\\')) //terminated |
             {
-                if ((i > 0) && (conclusio.at(i-1) == '\\')) //terminated |
-                {
-                    newRule.conclusion.remove(newRule.conclusion.size()-1);
-                    newRule.conclusion.append(conclusio.at(i).unicode());
-                }
+                conclusion->remove(conclusion->size()-1);
+                conclusion->append(conclusio.at(i).unicode());
+            }
+            else
+            {
+                if (!isNonTerminal)
+                    nonTerminalPos = i+1;
                 else
                 {
-                    if (!isNonTerminal)
-                        nonTerminalPos = i+1;
+                    QString tmpNonTerminal = conclusio.mid(nonTerminalPos, i-nonTerminalPos);
+                    EarleySymbol symbol;
+                    if (addUnknown)
+                        symbol = addNonTerminal(tmpNonTerminal);
                     else
-                    {
-                        QString         tmpNonTerminal = conclusio.mid(nonTerminalPos, i-nonTerminalPos);
-                        EarleySymbol    tmpNTConverted;
-                        tmpNTConverted = -nonTerminals.indexOf(tmpNonTerminal);      //find non terminal
-                        if (tmpNTConverted == 1)
-                        {
-                            qDebug() << "unknown rule";
-                            return false;
-                        }
-                        else
-                            newRule.conclusion.append(tmpNTConverted);
-                    }
-                    isNonTerminal = !isNonTerminal;
+                        symbol = nonTerminalSymbol(tmpNonTerminal);
+                    if (symbol == 0)
+                        return false;
+                    conclusion->append(symbol);
                 }
-            }
-            else if (!isNonTerminal)
-            {
-                newRule.conclusion.append(conclusio.at(i).unicode());
+                isNonTerminal = !isNonTerminal;
             }
         }
-    }
-
-    //remove the rule
-    QList<EarleyRule> ruleList = rules.at(-newRule.premise);
-    for (int i = (ruleList.size()-1); i >= 0; i--)
-    {
-        bool match = true;
-        if (ruleList.at(i).conclusion.size() != newRule.conclusion.size())
-            match = false;
-        else
+        else if (!isNonTerminal)
         {
-            for (int i2 = 0; i2 < ruleList.at(i).conclusion.size(); i2++)
-            {
-                if (ruleList.at(i).conclusion.at(i2) != newRule.conclusion.at(i2))
-                {
-                    match = false;
-                    break;
-                }
-            }
+            conclusion->append(conclusio.at(i).unicode());
         }
+    }
 
-        if (match)
-        {
-            rules[-newRule.premise].removeAt(i);
+    return true;
+}
 
-            itemListCount = 0;   //when a rule is changed, whole parsing needs to be done again
-            return true;
-        }
+QByteArray QEarleyParser::ruleKey(EarleySymbol premise, const QVector<EarleySymbol> &conclusion)
+{
+    QByteArray key(reinterpret_cast<const char*>(&premise), sizeof(EarleySymbol));
+    key.append(reinterpret_cast<const char*>(conclusion.constData()), conclusion.size() * sizeof(EarleySymbol));
+    return key;
+}
+
+void QEarleyParser::compactRules(int index)
+{
+    QList<EarleyRule> &ruleList = rules[index];
+    for (int i = ruleList.size()-1; i >= 0; i--)
+    {
+        if (ruleList.at(i).removed)
+            ruleList.removeAt(i);
     }
+    removedRuleCount[index] = 0;
 
-    qDebug() << "unknown rule";
-    return false;
+    for (int i = 0; i < ruleList.size(); i++)
+        ruleIndex.insert(ruleKey(ruleList.at(i).premise, ruleList.at(i).conclusion), i);
 }
 
 /*bool QEarleyParser::loadRules(QStringList ruleList)
@@ -222,91 +545,325 @@ bool QEarleyParser::removeRule(QString rule)
 }
 */
 
+void QEarleyParser::shareRules(const QEarleyParser *base)
+{
+    //the containers are implicitly shared, they are copied when this parser changes them the first time
+    rules = base->rules;
+    isNullableVector = base->isNullableVector;
+    isNullableDirty = base->isNullableDirty;
+    nonTerminals = base->nonTerminals;
+    nonTerminalIds = base->nonTerminalIds;
+    ruleIndex = base->ruleIndex;
+    removedRuleCount = base->removedRuleCount;
+    lexicons = base->lexicons;
+    startSymbol = base->startSymbol;
+    actionCodes = base->actionCodes;
+    ruleCounter = base->ruleCounter;
+    m_disambiguationPolicy = base->m_disambiguationPolicy;
+
+    clearWord();
+}
+
+void QEarleyParser::saveRules(QDataStream &stream)
+{
+    if (isNullableDirty)
+        updateNullable();
+
+    stream << nonTerminals << startSymbol << isNullableVector;
+    for (int i = 0; i < rules.size(); i++)
+    {
+        stream << static_cast<qint32>(rules.at(i).size() - removedRuleCount.at(i));
+        for (int j = 0; j < rules.at(i).size(); j++)
+        {
+            if (!rules.at(i).at(j).removed)
+                stream << rules.at(i).at(j).conclusion << rules.at(i).at(j).functions << static_cast<qint32>(rules.at(i).at(j).order);
+        }
+    }
+
+    stream << static_cast<qint32>(lexicons.size());
+    for (int i = 0; i < lexicons.size(); i++)
+    {
+        QStringList words = lexicons.at(i).words.toList();
+        words.sort();
+        stream << lexicons.at(i).name << words;
+    }
+}
+
+bool QEarleyParser::loadRules(QDataStream &stream)
+{
+    QStringList newNonTerminals;
+    EarleySymbol newStartSymbol;
+    QVector<bool> newNullableVector;
+
+    stream >> newNonTerminals >> newStartSymbol >> newNullableVector;
+    if ((stream.status() != QDataStream::Ok) || (newNullableVector.size() != newNonTerminals.size()))
+        return false;
+
+    QVector<QList<EarleyRule> > newRules(newNonTerminals.size());
+    QHash<QByteArray, int> newRuleIndex;
+    int newRuleCounter = 0;
+    for (int i = 0; (i < newRules.size()) && (stream.status() == QDataStream::Ok); i++)
+    {
+        qint32 ruleCount;
+        stream >> ruleCount;
+        for (int j = 0; (j < ruleCount) && (stream.status() == QDataStream::Ok); j++)
+        {
+            EarleyRule rule;
+            rule.premise = -i;
+            rule.removed = false;
+            stream >> rule.conclusion >> rule.functions >> rule.order;
+            rule.actions = resolveActions(rule.functions);      //action codes belong to the running program and are not stored
+            newRuleCounter = qMax(newRuleCounter, rule.order + 1);
+            newRuleIndex.insert(ruleKey(rule.premise, rule.conclusion), newRules.at(i).size());
+            newRules[i].append(rule);
+        }
+    }
+
+    qint32 lexiconCount;
+    stream >> lexiconCount;
+    QStringList lexiconNames;
+    QList<QStringList> lexiconWords;
+    for (int i = 0; (i < lexiconCount) && (stream.status() == QDataStream::Ok); i++)
+    {
+        QString name;
+        QStringList words;
+        stream >> name >> words;
+        lexiconNames.append(name);
+        lexiconWords.append(words);
+    }
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    clearWord();    // the items point to the old rules
+    initializeTerminalClasses();
+    nonTerminals = newNonTerminals;
+    nonTerminalIds.clear();
+    for (int i = 1; i < nonTerminals.size(); i++)
+        nonTerminalIds.insert(nonTerminals.at(i), i);
+    startSymbol = newStartSymbol;
+    isNullableVector = newNullableVector;
+    isNullableDirty = false;
+    rules = newRules;
+    ruleIndex = newRuleIndex;
+    ruleCounter = newRuleCounter;
+    removedRuleCount.fill(0, rules.size());
+
+    lexicons.clear();
+    for (int i = 0; i < lexiconNames.size(); i++)
+    {
+        EarleySymbol lexicon = addLexicon(lexiconNames.at(i));
+        foreach (QString lexiconWord, lexiconWords.at(i))
+            addLexiconWord(lexicon, lexiconWord);
+    }
+
+    return true;
+}
+
+void QEarleyParser::initializeTerminalClasses()
+{
+    static bool initialized = false;
+    if (initialized)
+        return;
+
+    enum {AnyCharClass = 0x01, AnyCharExceptExcludedClass = 0x02, AnyCharExceptEqualClass = 0x04};
+
+    for (int i = 0; i < 65536; i++)
+    {
+        terminalClasses[i] = 0;
+        characterClasses[i] = AnyCharClass | AnyCharExceptExcludedClass | AnyCharExceptEqualClass;
+    }
+    terminalClasses[ANY_CHAR] = AnyCharClass;
+    terminalClasses[ANY_CHAR_EXCEPT_EXCLUDED] = AnyCharExceptExcludedClass;
+    terminalClasses[ANY_CHAR_EXCEPT_EQUAL] = AnyCharExceptEqualClass;
+
+    characterClasses[int('=')] &= ~AnyCharExceptEqualClass;
+
+    QRegExp excludedChars(EXCLUDED_CHARS);      //all excluded chars are ASCII
+    for (int i = 0; i < 128; i++)
+    {
+        if (QString(QChar(i)).contains(excludedChars))
+            characterClasses[i] &= ~AnyCharExceptExcludedClass;
+    }
+
+    initialized = true;
+}
+
+void QEarleyParser::updateNullable()
+{
+    isNullableVector.fill(false);
+
+    bool changed = true;
+    while (changed)     //a nonTerminal is nullable if one of its rules consists of nullable nonTerminals only
+    {
+        changed = false;
+        for (int i = 1; i < rules.size(); i++)
+        {
+            if (isNullableVector.at(i))
+                continue;
+
+            foreach (const EarleyRule &rule, rules.at(i))
+            {
+                if (rule.removed)
+                    continue;
+
+                bool nullable = true;
+                foreach (EarleySymbol symbol, rule.conclusion)
+                {
+                    if ((symbol >= 0) || !isNullableVector.at(-symbol))
+                    {
+                        nullable = false;
+                        break;
+                    }
+                }
+                if (nullable)
+                {
+                    isNullableVector[i] = true;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    isNullableDirty = false;
+}
+
 EarleySymbol QEarleyParser::addNonTerminal(QString nonTerminal)
 {
-    if (nonTerminals.contains(nonTerminal))
-        return -nonTerminals.indexOf(nonTerminal);
-    else
+    //fixing the nonTerminal 0 problem, 0 is already a terminal
+    if (nonTerminals.isEmpty())
     {
-        nonTerminals.append(nonTerminal);
+        initializeTerminalClasses();
+        nonTerminals.append(QString());
         rules.append(QList<EarleyRule>());
+        removedRuleCount.append(0);
         isNullableVector.append(false);
-        return -(nonTerminals.size()-1);
     }
+
+    EarleySymbol symbol = nonTerminalSymbol(nonTerminal);
+    if ((symbol != 0) || nonTerminal.isEmpty())
+        return symbol;
+
+    nonTerminalIds.insert(nonTerminal, nonTerminals.size());
+    nonTerminals.append(nonTerminal);
+    rules.append(QList<EarleyRule>());
+    removedRuleCount.append(0);
+    isNullableVector.append(false);
+    return -(nonTerminals.size()-1);
 }
 
 void QEarleyParser::initialize()
 {
-    itemListCount = word.conclusion.size() + 1;
+    itemListCount = 0;
+    lexiconChangePosition = -1;
 
-    earleyItemLists.clear();
-    for (int i = 0; i < itemListCount; i++)
+    for (int i = 0; i <= word.conclusion.size(); i++)
+        appendItemSet();
+}
+
+void QEarleyParser::appendItemSet()
+{
+    if (itemListCount == earleyItemLists.size())    //the sets are kept and reused by later parses
     {
-        earleyItemLists.append(EarleyItemList());
+        earleyItemLists.append(new EarleyItemSet());
+        setAllocations++;
     }
+    earleyItemLists.at(itemListCount)->clear();     //the items of the last use of the set are released
+    itemListCount++;
+}
+
+int QEarleyParser::allocationCount() const
+{
+    int count = setAllocations;
+    for (int i = 0; i < earleyItemLists.size(); i++)
+        count += earleyItemLists.at(i)->allocations + earleyItemLists.at(i)->arena.allocations();
+    return count;
 }
 
 bool QEarleyParser::parse(int startPosition)
 {
     int currentIndex = startPosition;
 
+    if (isNullableDirty)
+        updateNullable();
+
     if (startPosition == 0)
     {
-        //predictor special case
+        //predictor special case, the rules are read through at() so a shared grammar is not detached
         for (int i = 0; i < rules.at(-startSymbol).size(); i++)
         {
-            appendEarleyItem(0, &rules[-startSymbol][i] ,0 , 0, NULL);
+            if (!rules.at(-startSymbol).at(i).removed)
+                appendEarleyItem(0, const_cast<EarleyRule*>(&rules.at(-startSymbol).at(i)) ,0 , 0, NULL, NULL);
         }
     }
 
     for (int listIndex = startPosition; listIndex < itemListCount; listIndex++)
     {
-        int oldcount = -1;
-        while (earleyItemLists.at(currentIndex).size() != oldcount)
-        {
-            oldcount = earleyItemLists.at(currentIndex).size();
+        EarleyItemSet &itemSet = *earleyItemLists.at(currentIndex);
 
-            for (int itemIndex = 0; itemIndex < earleyItemLists.at(currentIndex).size(); itemIndex++)
+        //the item set is the worklist, new items are appended behind the current one, one pass is enough
+        for (int itemIndex = 0; itemIndex < itemSet.size(); itemIndex++)
+        {
+            EarleyItem *item = &itemSet[itemIndex];
+            if (!(item->dotPos == item->rule->conclusion.size()))    //check for final state (beta is empty)
             {
-                EarleyItem *item = &earleyItemLists[currentIndex][itemIndex];
-                if (!(item->dotPos == item->rule->conclusion.size()))    //check for final state (beta is empty)
+                EarleySymbol firstSymbol = item->rule->conclusion.at(item->dotPos);
+                if (firstSymbol < 0)    //if symbol < 0, symbol = nonTerminal
                 {
-                    EarleySymbol firstSymbol = item->rule->conclusion.at(item->dotPos);
-                    if (firstSymbol < 0)    //if symbol < 0, symbol = nonTerminal
+                    //Predictor
+                    if (itemSet.markPredicted(firstSymbol))   //rules of a nonTerminal are only predicted once per set
                     {
-                        //Predictor
                         for (int i = 0; i < rules.at(-firstSymbol).size(); i++)
                         {
-                            appendEarleyItem(currentIndex, &(rules[-firstSymbol][i]) ,0 , currentIndex, item);
-                        }
-                        //Aycock and Horspool Epsilon solution
-                        if (isNullableVector.at(-firstSymbol))  //if B is nullable
-                        {
-                            appendEarleyItem(currentIndex, item->rule, item->dotPos+1, item->startPos, item);   //move point right
+                            if (!rules.at(-firstSymbol).at(i).removed)
+                                appendEarleyItem(currentIndex, const_cast<EarleyRule*>(&rules.at(-firstSymbol).at(i)) ,0 , currentIndex, NULL, NULL);
                         }
                     }
-                    else if (currentIndex < (itemListCount-1))
+                    //Aycock and Horspool Epsilon solution
+                    if (isNullableVector.at(-firstSymbol))  //if B is nullable
                     {
-                        //Scanner
-                        if ((word.conclusion.at(currentIndex) == firstSymbol)
-                                || (firstSymbol == 127)
-                                || ((firstSymbol == 26) && (word.conclusion.at(currentIndex) != '='))
-                                || ((firstSymbol == 27) && !QString(word.conclusion.at(currentIndex)).contains(QRegExp(EXCLUDED_CHARS))))  //127 is the any+ char, 27 the any char
-                        {
-                            appendEarleyItem(currentIndex+1, item->rule, item->dotPos+1, item->startPos, item);   //move point right
-                        }
+                        appendEarleyItem(currentIndex, item->rule, item->dotPos+1, item->startPos, item, NULL);   //move point right
+                    }
+                }
+                else if ((firstSymbol >= LEXICON_SYMBOL_BASE) && (currentIndex < (itemListCount-1)))
+                {
+                    //Lexer, a token terminal walks the trie of its lexicon by one character per set
+                    const EarleyLexicon &lexicon = lexicons.at(firstSymbol - LEXICON_SYMBOL_BASE);
+                    int node = lexicon.nodes.at(item->lexState).children.value(word.conclusion.at(currentIndex), 0);
+                    if (node != 0)
+                    {
+                        if (!lexicon.nodes.at(node).children.isEmpty())
+                            appendEarleyItem(currentIndex+1, item->rule, item->dotPos, item->startPos, item, NULL, node);    //word continues
+                        if (lexicon.nodes.at(node).isWord)
+                            appendEarleyItem(currentIndex+1, item->rule, item->dotPos+1, item->startPos, item, NULL);        //word complete, move point right
+                    }
+                }
+                else if (currentIndex < (itemListCount-1))
+                {
+                    //Scanner
+                    EarleySymbol character = word.conclusion.at(currentIndex);
+                    if ((character == firstSymbol)
+                            | ((terminalClasses[firstSymbol] & characterClasses[character]) != 0))  //wildcard terminals match by class
+                    {
+                        appendEarleyItem(currentIndex+1, item->rule, item->dotPos+1, item->startPos, item, NULL);   //move point right
                     }
                 }
+            }
+            else
+            {
+                //Completer, only visits the items waiting for the premise
+                EarleyLeoItem leo;
+                if ((item->startPos < currentIndex) && leoItem(item->startPos, item->premise(), &leo))
+                {
+                    //Leo: deterministic reduction path, only the topmost item is completed
+                    appendEarleyItem(currentIndex, leo.rule, leo.rule->conclusion.size(), leo.startPos, NULL, item);
+                }
                 else
                 {
-                    //Completer
-                    for (int i = 0; i < earleyItemLists.at(item->startPos).size(); i++)
+                    EarleyItemSet &originSet = *earleyItemLists.at(item->startPos);
+                    for (EarleyItem *item2 = originSet.firstWaitingItem(item->premise()); item2 != NULL; item2 = originSet.nextWaitingItem(item2))
                     {
-                        EarleyItem *item2 = &earleyItemLists[item->startPos][i];
-                        if (!(item2->dotPos == item2->rule->conclusion.size()) && (item2->rule->conclusion.at(item2->dotPos) == item->premise()))  //item2 is not empty and item2 B = item A
-                        {
-                            appendEarleyItem(currentIndex, item2->rule, item2->dotPos+1, item2->startPos, item);   //move point right
-                        }
+                        appendEarleyItem(currentIndex, item2->rule, item2->dotPos+1, item2->startPos, item2, item);   //move point right
                     }
                 }
             }
@@ -314,17 +871,19 @@ bool QEarleyParser::parse(int startPosition)
         currentIndex++;
     }
 
-    isRecursionDone = false;        //the itemLists are fine and partial parsing is possible
-
     //check wheter parsing was successful or not
     return checkSuccessful();
 }
 
 bool QEarleyParser::checkSuccessful()
 {
-    for (int i = 0; i < earleyItemLists.last().size(); i++)
+    if (itemListCount == 0)
+        return false;
+
+    EarleyItemSet &lastSet = *earleyItemLists.at(itemListCount-1);
+    for (int i = 0; i < lastSet.size(); i++)
     {
-        EarleyItem *item = &earleyItemLists.last()[i];
+        EarleyItem *item = &lastSet[i];
         if ((item->premise() == startSymbol) && (item->dotPos == item->rule->conclusion.size()))
             return true;
     }
@@ -344,7 +903,29 @@ void QEarleyParser::setWord(QString earleyWord)
 
 void QEarleyParser::setStartSymbol(QString earleyStartSymbol)
 {
-    startSymbol = -nonTerminals.indexOf(earleyStartSymbol);
+    startSymbol = nonTerminalSymbol(earleyStartSymbol);
+}
+
+void QEarleyParser::setActions(QStringList actionNames)
+{
+    actionCodes.clear();
+    for (int i = 0; i < actionNames.size(); i++)
+        actionCodes.insert(actionNames.at(i), i);
+
+    for (int i = 0; i < rules.size(); i++)
+    {
+        for (int j = 0; j < rules.at(i).size(); j++)
+            rules[i][j].actions = resolveActions(rules.at(i).at(j).functions);
+    }
+}
+
+QVector<int> QEarleyParser::resolveActions(const QStringList &functions) const
+{
+    QVector<int> actions;
+    actions.reserve(functions.size());
+    foreach (QString function, functions)
+        actions.append(actionCodes.value(function, -1));
+    return actions;
 }
 
 // this function is only for testing purposes
@@ -357,27 +938,18 @@ bool QEarleyParser::parseWord(QString earleyWord)
 void QEarleyParser::clearWord()
 {
     itemListCount = 0;
+    lexiconChangePosition = -1;
     word.conclusion.clear();
-    earleyItemLists.clear();
 }
 
 bool QEarleyParser::addSymbol(QChar earleySymbol)
 {
     word.conclusion.append(earleySymbol.unicode());
 
-    if (itemListCount != 0) //rules changed
+    if ((itemListCount != 0) && (lexiconChangePosition == -1)) //rules changed
     {
-        itemListCount++;
-        earleyItemLists.append(EarleyItemList());
-
-        if (isRecursionDone)    // if tree was already created whole parsing needs to be done
-        {
-            for (int i = 0; i < itemListCount; i++)
-                earleyItemLists[i].clear();
-            return parse();
-        }
-        else                    //else partial parsing is possible
-            return parse(itemListCount-2);
+        appendItemSet();
+        return parse(itemListCount-2);      //the forest is kept, only the last set needs to be scanned again
     }
     else
     {
@@ -390,10 +962,9 @@ bool QEarleyParser::removeSymbol()
 {
     if (word.conclusion.size() > 0)
         word.conclusion.remove(word.conclusion.size()-1);
-    if (itemListCount != 0) // rules changed
+    if ((itemListCount != 0) && (lexiconChangePosition == -1)) // rules changed
     {
         itemListCount--;
-        earleyItemLists.removeLast();
         return checkSuccessful();
     }
     else
@@ -403,87 +974,131 @@ bool QEarleyParser::removeSymbol()
     }
 }
 
-void QEarleyParser::appendEarleyItem(int index, EarleyRule *rule, int dotPos, int K, EarleyItem *origin)
+bool QEarleyParser::updateWord(QString earleyWord)
 {
-    /*bool match = false;
-    foreach (EarleyItem item, earleyItemLists.at(index))
+    if (itemListCount == 0) // rules changed
     {
-        match |= (item.A == A) && (item.alpha == alpha) && (item.beta == beta) && (item.K == K);
-        if (match)
-            return;
-    }*/
+        setWord(earleyWord);
+        return parse();
+    }
 
-    EarleyItem earleyItem;
-    earleyItem.rule = rule;
-    earleyItem.dotPos = dotPos;
-    earleyItem.startPos = K;
-    earleyItem.origin = origin;
+    // the sets up to the first changed character only depend on the unchanged prefix and are kept,
+    // the last of them is parsed again to scan the new character
+    int prefixLength = 0;
+    while ((prefixLength < earleyWord.size()) && (prefixLength < word.conclusion.size())
+           && (earleyWord.at(prefixLength).unicode() == word.conclusion.at(prefixLength)))
+        prefixLength++;
 
-    if (!earleyItemLists.at(index).contains(earleyItem))
-        earleyItemLists[index].append(earleyItem);
-    else
-        return;
+    // a changed lexicon word only invalidates the sets behind its first occurrence
+    if ((lexiconChangePosition != -1) && (lexiconChangePosition < prefixLength))
+        prefixLength = lexiconChangePosition;
+    lexiconChangePosition = -1;
 
-    //qDebug() << index << A << *rule << dotPos << K;
-}
+    itemListCount = prefixLength + 1;
+    word.conclusion.resize(prefixLength);
 
-void QEarleyParser::treeRecursion(int listIndex, int itemIndex, EarleyItemList& tree)
-{
-    if (tree.at(0).dotPos == 0)  //first element (the start rule) must be backward completed
+    for (int i = prefixLength; i < earleyWord.size(); i++)
     {
-        earleyItemResultLists = tree;  //save tree to global variable
+        word.conclusion.append(earleyWord.at(i).unicode());
+        appendItemSet();
     }
-    else
+
+    return parse(prefixLength);
+}
+
+bool QEarleyParser::leoItem(int index, EarleySymbol symbol, EarleyLeoItem *leo)
+{
+    // A set has a transitive item for symbol if exactly one item waits for symbol and symbol is the
+    // last symbol of its rule, completing symbol then completes only this item. If the rule of the
+    // item has no functions the item is skipped and the path continues in the set the item started.
+    // Skipping only function-less items keeps the items collected by backtraceTree the same.
+    struct LeoStep {
+        int             index;
+        EarleySymbol    symbol;
+        EarleyLeoItem   candidate;
+    };
+    QVector<LeoStep> path;
+    EarleyLeoItem result;
+    result.rule = NULL;
+    result.startPos = 0;
+
+    forever
     {
-        if (tree.at(itemIndex).dotPos != 0)   //alpha is not empty
-        {
-            EarleySymbol lastSymbol = tree.at(itemIndex).rule->conclusion.at(tree.at(itemIndex).dotPos-1);   //symbol before dot
-            if (lastSymbol < 0)     //if symbol < 0, symbol = nonTerminal
-            {
-                //backward predictor
-                int kj = tree.at(itemIndex).startPos;
-                int pj = tree.at(itemIndex).dotPos;
-                for (int i = 0; i < earleyItemLists.at(listIndex).size(); i++)//foreach (EarleyItem item, earleyItemLists.at(listIndex))
-                {
-                    EarleyItem *item = &earleyItemLists[listIndex][i];
-                    if ((item->premise() == lastSymbol) && (item->dotPos == item->rule->conclusion.size()) && (item->startPos >= (kj+pj-1)))
-                    {
-                        EarleyItemList treeCopy = tree;
-                        treeCopy.insert(itemIndex+1,*item);
-                        treeRecursion(listIndex, itemIndex+1, treeCopy);
-                    }
-                }
-            }
-            else
-            {
-                //backward scanner
-                if ((word.conclusion.at(listIndex-1) == tree[itemIndex].prevSymbol()) || (word.conclusion.at(listIndex-1) == 127))
-                {
-                    tree[itemIndex].dotPos--;       //move dot left
-                    treeRecursion(listIndex-1, itemIndex, tree);
-                }
-                else
-                {
-                    tree.removeAt(itemIndex);
-                }
-            }
-        }
-        else
+        EarleyItemSet &itemSet = *earleyItemLists.at(index);
+        if (itemSet.leoItem(symbol, &result))
+            break;
+
+        EarleyItem *waitingItem = itemSet.firstWaitingItem(symbol);
+        if ((waitingItem == NULL) || (itemSet.nextWaitingItem(waitingItem) != NULL)
+                || (waitingItem->dotPos != (waitingItem->rule->conclusion.size()-1)))
         {
-            //backward completer
-            if (itemIndex > 0)
-            {
-                int kj = tree.at(itemIndex).startPos;
-                int kj1 = tree.at(itemIndex-1).startPos;
-                int pj1 = tree.at(itemIndex-1).dotPos;
-                if ((pj1 > 1) || ((pj1 == 1) && (kj == kj1)))
-                {
-                    tree[itemIndex-1].dotPos--;                  //move point left
-                    treeRecursion(listIndex, itemIndex-1, tree);
-                }
-            }
+            itemSet.setLeoItem(symbol, result);      //no deterministic path
+            break;
         }
+
+        LeoStep step;
+        step.index = index;
+        step.symbol = symbol;
+        step.candidate.rule = waitingItem->rule;
+        step.candidate.startPos = waitingItem->startPos;
+        path.append(step);
+
+        if (!waitingItem->rule->functions.isEmpty() || (waitingItem->startPos >= index))
+            break;      //item can't be skipped, it is the topmost item
+
+        symbol = waitingItem->premise();
+        index = waitingItem->startPos;
     }
+
+    //the topmost item of the upper set is the result of the lower ones, else their own completed item
+    for (int i = path.size()-1; i >= 0; i--)
+    {
+        if (result.rule == NULL)
+            result = path.at(i).candidate;
+        earleyItemLists.at(path.at(i).index)->setLeoItem(path.at(i).symbol, result);
+    }
+
+    *leo = result;
+    return (result.rule != NULL);
+}
+
+void QEarleyParser::appendEarleyItem(int index, EarleyRule *rule, int dotPos, int K, EarleyItem *predecessor, EarleyItem *child, int lexState)
+{
+    EarleyItem earleyItem;
+    earleyItem.rule = rule;
+    earleyItem.dotPos = dotPos;
+    earleyItem.startPos = K;
+    earleyItem.endPos = index-1;
+    earleyItem.predecessor = predecessor;
+    earleyItem.child = child;
+    earleyItem.alternative = -1;
+    earleyItem.nextWaiting = -1;
+    earleyItem.lexState = lexState;
+
+    EarleyItemSet &itemSet = *earleyItemLists.at(index);
+    int itemIndex;
+    if (itemSet.append(earleyItem, &itemIndex))     //hashed lookup
+        return;
+
+    //the item exists, a new derivation is packed into it
+    EarleyItem *existingItem = &itemSet[itemIndex];
+    if ((existingItem->predecessor == predecessor) && (existingItem->child == child))
+        return;
+    int *link = &existingItem->alternative;
+    while (*link != -1)
+    {
+        const EarleyPackedNode &packedNode = itemSet.packedNodes.at(*link);
+        if ((packedNode.predecessor == predecessor) && (packedNode.child == child))
+            return;
+        link = &itemSet.packedNodes[*link].next;
+    }
+
+    EarleyPackedNode packedNode;
+    packedNode.predecessor = predecessor;
+    packedNode.child = child;
+    packedNode.next = -1;
+    *link = itemSet.packedNodes.size();
+    itemSet.appendPackedNode(packedNode);
 }
 
 QString QEarleyParser::EarleyItemToString(EarleyItem item)
@@ -496,6 +1111,8 @@ QString QEarleyParser::EarleyItemToString(EarleyItem item)
         if (item.dotPos == i) itemString.append("@");
         if (item.rule->conclusion[i] < 0)
             itemString.append("|" + nonTerminals.at(-item.rule->conclusion[i]) + "|");
+        else if (item.rule->conclusion[i] >= LEXICON_SYMBOL_BASE)
+            itemString.append("{" + lexicons.at(item.rule->conclusion[i] - LEXICON_SYMBOL_BASE).name + "}");
         else
             itemString.append(QChar(item.rule->conclusion[i]));
     }
@@ -508,75 +1125,102 @@ QList<EarleyTreeItem> QEarleyParser::getTree()
 {
     EarleyItemList tree;
 
-    //remove unneeded items
-    for (int listIndex = 0; listIndex < itemListCount; listIndex++)
-    {
-        for (int i = earleyItemLists.at(listIndex).size()-1; i >= 0 ; i--)
-        {
-            earleyItemLists[listIndex][i].endPos = listIndex-1;  //store end position of item for later use in evaluation
-            /*if (!(earleyItemLists.at(listIndex).at(i).dotPos == earleyItemLists.at(listIndex).at(i).rule->conclusion.size()))  //not beta is empty
-                earleyItemLists[listIndex].removeAt(i);*/
-        }
-    }
-    isRecursionDone = true;     //must be set, lists are destroyed and partial parsing is not possible any more
-
-    //for testing purposes only
-    /*qDebug() << "Earley items after Parsing:";
-    for (int x = 0; x < itemListCount; x++)
-    {
-        for (int y = 0; y < earleyItemLists.at(x).size(); y++)
-        //foreach (EarleyItem item, earleyItemLists.at(x))
-        {
-            EarleyItem *item = &earleyItemLists[x][y];
-            qDebug() << x << item << EarleyItemToString(*item) << item->startPos << item->origin;
-        }
-    }*/
-
     backtraceTree(&tree);
 
-    //add the final item
-    /*for (int i = 0; i < earleyItemLists.last().size(); i++)
-    {
-        EarleyItem *item = &earleyItemLists.last()[i];
-        if ((item->premise() == startSymbol) && (item->dotPos == item->rule->conclusion.size()))
-        {
-            tree.append(*item);
-        }
-    }
-
-    treeRecursion(itemListCount-1,0,tree);
-
-    tree = earleyItemResultLists; //result has been stored in the deepest stack level of recursion
-    */
     //for testing purposes only
-    /*qDebug() << "Earley items after tree recursion:";
+    /*qDebug() << "Earley items of the tree:";
     foreach (EarleyItem item, tree)
     {
-        qDebug() << EarleyItemToString(item) << item.startPos;
+        qDebug() << EarleyItemToString(item) << item.startPos << item.endPos;
     }
     qDebug();*/
 
     return tree;
 }
 
+void QEarleyParser::setDisambiguationPolicy(QEarleyParser::DisambiguationPolicy policy)
+{
+    m_disambiguationPolicy = policy;
+}
+
+QEarleyParser::DisambiguationPolicy QEarleyParser::disambiguationPolicy() const
+{
+    return m_disambiguationPolicy;
+}
+
 void QEarleyParser::backtraceTree(EarleyItemList *tree)
 {
-    EarleyItem *currentItem = NULL;
+    EarleyItem *rootItem = NULL;
 
     //get the startItem
-    for (int i = 0; i < earleyItemLists.last().size(); i++)
+    if (itemListCount == 0)
+        return;
+
+    EarleyItemSet &lastSet = *earleyItemLists.at(itemListCount-1);
+    for (int i = 0; i < lastSet.size(); i++)
     {
-        EarleyItem *item = &earleyItemLists.last()[i];
-        if ((item->premise() == startSymbol) && (item->isFinal()))
+        EarleyItem *item = &lastSet[i];
+        if ((item->premise() == startSymbol) && (item->isFinal())
+                && ((rootItem == NULL) || (m_disambiguationPolicy == FirstDerivation) || (item->rule->order < rootItem->rule->order)))
         {
-            currentItem = item;
+            rootItem = item;
         }
     }
+    if (rootItem == NULL)
+        return;
 
-    while (currentItem->origin != NULL)
+    //depth first walk without recursion, the completed child is visited before the predecessor
+    QStack<EarleyItem*> stack;
+    stack.push(rootItem);
+    while (!stack.isEmpty())
     {
-        if (currentItem->isFinal() && !currentItem->rule->functions.isEmpty())
-            tree->append(*currentItem);
-        currentItem = currentItem->origin;
+        EarleyItem *item = stack.pop();
+        if (item->isFinal() && !item->rule->functions.isEmpty())
+            tree->append(*item);
+
+        EarleyPackedNode derivation = chooseDerivation(item);
+        if ((derivation.predecessor == NULL) && (derivation.child != NULL))
+        {
+            //Leo item, the skipped items of the deterministic reduction path are the only items waiting in their sets
+            QVector<EarleyItem*> path;
+            EarleyItem *pathItem = derivation.child;
+            do
+            {
+                pathItem = earleyItemLists.at(pathItem->startPos)->firstWaitingItem(pathItem->premise());
+                path.append(pathItem);
+            } while ((pathItem->rule != item->rule) || (pathItem->startPos != item->startPos));
+
+            for (int i = path.size()-1; i >= 0; i--)
+                stack.push(path.at(i));
+        }
+        else if (derivation.predecessor != NULL)
+        {
+            stack.push(derivation.predecessor);
+        }
+
+        if (derivation.child != NULL)
+            stack.push(derivation.child);
     }
 }
+
+EarleyPackedNode QEarleyParser::chooseDerivation(EarleyItem *item)
+{
+    EarleyPackedNode derivation;
+    derivation.predecessor = item->predecessor;
+    derivation.child = item->child;
+    derivation.next = item->alternative;
+
+    if (m_disambiguationPolicy == GrammarOrder)
+    {
+        //the lowest order of the completed child wins, derivations without child keep the first one
+        const EarleyItemSet &itemSet = *earleyItemLists.at(item->endPos+1);
+        for (int i = item->alternative; i != -1; i = itemSet.packedNodes.at(i).next)
+        {
+            const EarleyPackedNode &packedNode = itemSet.packedNodes.at(i);
+            if ((packedNode.child != NULL) && ((derivation.child == NULL) || (packedNode.child->rule->order < derivation.child->rule->order)))
+                derivation = packedNode;
+        }
+    }
+
+    return derivation;
+}
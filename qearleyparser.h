@@ -21,28 +21,40 @@
 #define QEARLEYPARSER_H
 
 #define EXCLUDED_CHARS "[:=@<>!,+-*/<>\\^()]"  /// RegExp with the excluded chars of the any character
+#define ANY_CHAR                    127 /// \* terminal, matches any character
+#define ANY_CHAR_EXCEPT_EXCLUDED    27  /// \~ terminal, matches any character except the EXCLUDED_CHARS
+#define ANY_CHAR_EXCEPT_EQUAL       26  /// \+ terminal, matches any character except =
+#define LEXICON_SYMBOL_BASE         0x10000 /// token terminals start here, a token terminal matches any word of its lexicon
 
 #include <QObject>
 #include <QStringList>
 #include <QMultiHash>
+#include <QSet>
+#include <QStack>
 #include <QPoint>
 #include <QDebug>
+#include <QDataStream>
 
 typedef qint32                  EarleySymbol; /// datatype of one symbol
 struct EarleyRule {
     EarleySymbol premise;
     QVector<EarleySymbol> conclusion;
     QStringList functions;
+    QVector<int> actions;       /// the functions resolved to action codes, -1 for functions without a code
+    bool removed;               /// removed rules stay in their list until it is compacted
+    int order;                  /// load order of the rule, used by the GrammarOrder disambiguation
 };
 
 struct EarleyItem {
     EarleyRule      *rule;      /// reference to the rule
     int             dotPos;     /// the position of the dot, left side recognized, right side not recognized
     int             startPos;   /// backpointer of the item
-    int             endPos;     /// will contain the end position of this item (unused during parsing)
-    EarleyItem      *origin;    /// contains a link to the origin of the item
-
-
+    int             endPos;     /// the end position of this item, set when the item is added
+    EarleyItem      *predecessor;   /// first derivation: the item with the dot one symbol to the left, NULL for predicted and Leo items
+    EarleyItem      *child;     /// first derivation: the completed item of the nonTerminal left to the dot, NULL for terminals
+    int             alternative;    /// index of the next derivation in packedNodes of the item set, -1 if there is none
+    int             nextWaiting;    /// index of the next item of the set expecting the same nonterminal, -1 if there is none
+    int             lexState;   /// lexicon node reached while scanning a token terminal, 0 if the token is not started
 
     EarleySymbol premise() {return rule->premise;}                          /// premise
     bool isInitial() {return dotPos==0;}                                    /// return true if dot is at the start
@@ -57,57 +69,186 @@ struct EarleyItem {
     void operator --() {if (dotPos>0) dotPos--;}                            /// move dot one step left
     bool operator ==(const EarleyItem &item) const                          /// compare items
     {
-        return (rule == item.rule) && (dotPos == item.dotPos) && (startPos == item.startPos);
+        return (rule == item.rule) && (dotPos == item.dotPos) && (startPos == item.startPos) && (lexState == item.lexState);
     }
 };
 
 typedef EarleyItem EarleyTreeItem;
 
+struct EarleyLeoItem {
+    EarleyRule      *rule;      /// rule of the topmost item of a deterministic reduction path, NULL if there is no such path
+    int             startPos;   /// backpointer of the topmost item
+};
+
+struct EarleyPackedNode {
+    EarleyItem      *predecessor;   /// the item with the dot one symbol to the left
+    EarleyItem      *child;     /// the completed item of the nonTerminal left to the dot
+    int             next;       /// index of the next derivation of the same item, -1 if there is none
+};
+
+struct EarleyLexiconNode {
+    QHash<EarleySymbol, int> children;  /// next node for every character
+    bool            isWord;     /// a word of the lexicon ends here
+};
+
+struct EarleyLexicon {
+    QString         name;       /// name of the lexicon
+    QVector<EarleyLexiconNode> nodes;   /// character trie of all words, node 0 is the root
+    QSet<QString>   words;      /// all words of the lexicon
+};
+
+class EarleyItemArena {
+public:
+    EarleyItemArena();
+    ~EarleyItemArena();
+
+    EarleyItem *allocate();                                                 ///< returns storage for one item, the address stays valid until the arena is reset
+    void reset() {chunkIndex = 0; used = 0;}                                /// releases all items at once, the chunks are kept for the next items
+    int allocations() const {return chunks.size();}                         /// count of chunks allocated from the heap
+
+private:
+    enum {FirstChunkSize = 16};     /// items of the first chunk, every further chunk is twice as big
+
+    QVector<EarleyItem*>    chunks;     /// the allocated chunks, never freed before destruction
+    int                     chunkIndex; /// the chunk items are taken from
+    int                     used;       /// count of items taken from the current chunk
+
+    Q_DISABLE_COPY(EarleyItemArena)
+};
+
+struct EarleySymbolSlot {
+    EarleySymbol    symbol;         /// the nonterminal
+    int             firstWaiting;   /// index of the first item expecting the nonterminal next, -1 if there is none
+    int             lastWaiting;    /// index of the last item expecting the nonterminal next
+    bool            predicted;      /// the rules of the nonterminal were already predicted in this set
+    bool            hasLeoItem;     /// leoItem holds the memorized Leo transitive item
+    EarleyLeoItem   leoItem;        /// memorized Leo transitive item of the nonterminal
+};
+
+struct EarleyItemSet {
+    QVector<EarleyItem*> items;     /// the items in insertion order, they live in the arena of the set so the forest links stay valid
+    QVector<int>        hashTable;  /// open addressing table with indexes into items, -1 marks an empty slot
+    QVector<EarleySymbolSlot> symbolSlots;  /// state of the nonterminals used in this set
+    QVector<int>        symbolTable;    /// open addressing table with indexes into symbolSlots, -1 marks an empty slot
+    QVector<EarleyPackedNode> packedNodes;  /// further derivations of ambiguous items, the first derivation is stored in the item
+    EarleyItemArena     arena;      /// storage of the items, clearing the set releases them
+    int                 allocations;    /// count of buffer growths, not reset by clear
+
+    EarleyItemSet() : allocations(0) {}
+
+    int size() const {return items.size();}                                 /// count of items
+    EarleyItem &operator [](int i) {return *items[i];}                      /// item at position i
+    const EarleyItem &at(int i) const {return *items.at(i);}                /// item at position i
+    void clear();                                                           ///< removes all items, the buffers are kept for the next parse
+
+    bool append(const EarleyItem &item, int *index);                        ///< appends the item if no equal item exists, returns wheter the item was appended, index is set to the position of the item
+    void appendPackedNode(const EarleyPackedNode &packedNode);              ///< appends a derivation to packedNodes
+    EarleyItem *firstWaitingItem(EarleySymbol symbol);                      ///< returns the first item expecting symbol next or NULL
+    EarleyItem *nextWaitingItem(const EarleyItem *item);                    ///< returns the next item expecting the same symbol or NULL
+    bool markPredicted(EarleySymbol symbol);                                ///< marks symbol as predicted, returns false if it already was
+    bool leoItem(EarleySymbol symbol, EarleyLeoItem *leo);                  ///< gets the memorized Leo transitive item, returns false if none is memorized
+    void setLeoItem(EarleySymbol symbol, const EarleyLeoItem &leo);         ///< memorizes a Leo transitive item
+
+private:
+    static uint hash(const EarleyItem &item);                               ///< hash over rule, dotPos and startPos
+    int find(const EarleyItem &item) const;                                 ///< returns the slot holding the item or the empty slot it belongs to
+    void rehash(int capacity);                                              ///< rebuilds the hash table with the given capacity
+    EarleySymbolSlot *symbolSlot(EarleySymbol symbol, bool create);         ///< returns the state of a nonterminal, NULL if it is not used and create is not set
+    template <typename T> void grow(QVector<T> &vector)                     /// counts the reallocations of a buffer
+    {
+        if (vector.size() == vector.capacity())
+            allocations++;
+    }
+};
+
 class QEarleyParser : public QObject
 {
     Q_OBJECT
 public:
     typedef QList<EarleyItem> EarleyItemList;
 
+    /** Choice between the derivations of an ambiguous item when the tree is extracted */
+    enum DisambiguationPolicy {
+        FirstDerivation,        /// the derivation found first wins
+        GrammarOrder            /// the derivation whose completed child has the rule loaded first wins
+    };
+
     explicit QEarleyParser(QObject *parent = 0);
+    ~QEarleyParser();
 
 //    bool loadRules(QStringList ruleList);                               ///< loads the rules from a string list and fills nonTerminals and terminals
     bool loadRule(QString rule, QStringList functions);                 ///< loads one rule
+    bool loadRule(EarleySymbol premise, const QVector<EarleySymbol> &conclusion, QStringList functions);  ///< loads one rule given as symbols, loading an active rule again does nothing
     bool removeRule(QString rule);                                      ///< removes one rule
+    bool removeRule(EarleySymbol premise, const QVector<EarleySymbol> &conclusion);  ///< removes one rule given as symbols
+    EarleySymbol nonTerminalSymbol(QString name) const;                 ///< returns the symbol of a nonTerminal, 0 if it is unknown, symbols stay valid as long as the grammar is not reloaded
+    QString nonTerminalName(EarleySymbol symbol) const;                 ///< returns the name of a nonTerminal symbol
+    EarleySymbol addLexicon(QString name);                              ///< adds a lexicon and returns its token terminal, rules use the token terminal to match any word of the lexicon
+    EarleySymbol lexiconSymbol(QString name) const;                     ///< returns the token terminal of a lexicon, 0 if it is unknown
+    bool addLexiconWord(EarleySymbol lexicon, QString word);            ///< adds a word to a lexicon
+    bool removeLexiconWord(EarleySymbol lexicon, QString word);         ///< removes a word from a lexicon
     void setStartSymbol(QString earleyStartSymbol);                     ///< sets the start symbol
+    void setActions(QStringList actionNames);                           ///< sets the functions with an action code, the code is the index in actionNames, all rules are resolved again
+    void shareRules(const QEarleyParser *base);                         ///< replaces the grammar with the grammar of base, the rules are copied only when they are changed
+    void saveRules(QDataStream &stream);                                ///< writes the compiled grammar to a stream
+    bool loadRules(QDataStream &stream);                                ///< replaces the grammar with a compiled grammar from a stream, returns successful
     bool parse(int startPosition = 0);                                  ///< starts to parse from start position, return wheter parsing was successful or not
     bool parseWord(QString earleyWord);                                 ///< parse the given word, returns wheter word can be build with the given grammar or not
     void clearWord();                                                   ///< clears the word
     bool addSymbol(QChar earleySymbol);                                 ///< adds one symbol to word and parses it, return is same as parseWord
     bool removeSymbol();                                                ///< removes one symbol from word and parses it, return is same as parseWord
-    QList<EarleyTreeItem> getTree();                                    ///< creates and returns the binary tree
+    bool updateWord(QString earleyWord);                                ///< replaces the word and parses only the part behind the common prefix, return is same as parseWord
+    QList<EarleyTreeItem> getTree();                                    ///< extracts one tree from the parse forest, the completed items with functions in reverse evaluation order
+    void setDisambiguationPolicy(DisambiguationPolicy policy);          ///< sets how getTree chooses between ambiguous derivations
+    DisambiguationPolicy disambiguationPolicy() const;                  ///< returns how getTree chooses between ambiguous derivations
     QString EarleyItemToString(EarleyItem item);                        ///< converts an Earley-item into a string for debugging
+    int allocationCount() const;                                        ///< returns the count of heap allocations of the item storage, stays constant when parsing is in steady state
 
 
 private:
 
     QVector<QList<EarleyRule> >     rules;                  /// vector holding all rules, index is index in nonTerminals
     QVector<bool>                   isNullableVector;       /// vector holding wheter a nonTerminal at index is nullable or not, needed for epsilon rules
-    QStringList                     nonTerminals;           /// contains all nonTerminals
+    bool                            isNullableDirty;        /// rules changed, isNullableVector needs to be updated before parsing
+    QStringList                     nonTerminals;           /// contains all nonTerminals, index is -symbol
+    QHash<QString, int>             nonTerminalIds;         /// index in nonTerminals of every nonTerminal name
+    QHash<QByteArray, int>          ruleIndex;              /// position in its rule list of every active rule, key is made by ruleKey
+    QVector<int>                    removedRuleCount;       /// count of removed rules in the rule list of a nonTerminal
+    QVector<EarleyLexicon>          lexicons;               /// lexicons of the token terminals, index is symbol - LEXICON_SYMBOL_BASE
     EarleySymbol                    startSymbol;            /// the start symbol
+    QHash<QString, int>             actionCodes;            /// action code of every function name set by setActions
 
 
-    QList<EarleyItemList>           earleyItemLists;        /// holds the item lists
-    EarleyItemList                  earleyItemResultLists;  /// holds the resulting tree of the recursive tree walk
+    QList<EarleyItemSet*>           earleyItemLists;        /// holds the item lists, the items and their packed nodes form the parse forest, sets behind itemListCount are kept for reuse
     int                             itemListCount;          /// the count of item lists needed for pasing
-    bool                            isRecursionDone;        /// holds wheter a tree recursion was done or not, needed for partial parsing
+    int                             lexiconChangePosition;  /// first item set that has to be processed again because a lexicon word changed, -1 if none
+    int                             setAllocations;         /// count of item sets created
+    int                             ruleCounter;            /// load order number of the next rule
+    DisambiguationPolicy            m_disambiguationPolicy; /// how getTree chooses between ambiguous derivations
 
     EarleyRule word;                                        /// word that should be parsed
 
+    static quint8 terminalClasses[65536];                   /// wildcard class bit of every terminal, 0 for ordinary characters
+    static quint8 characterClasses[65536];                  /// wildcard class bits every character of the word matches
+
 
 
     void initialize();                                                                              ///< initializes variables and lists for the parser
+    void appendItemSet();                                                                           ///< appends an empty item set, reusing a kept one if possible
     void setWord(QString earleyWord);                                                               ///< sets the word for pasing
-    void treeRecursion(int listIndex, int itemIndex, EarleyItemList& tree);                         ///< recursive function to create the binary tree
-    void appendEarleyItem(int index, EarleyRule *rule, int dotPos, int K, EarleyItem *origin);      ///< appends an item to the given ItemList (index), checks also for duplicates
+    bool leoItem(int index, EarleySymbol symbol, EarleyLeoItem *leo);                               ///< gets the Leo transitive item for symbol completed from set index, returns false if there is none
+    void appendEarleyItem(int index, EarleyRule *rule, int dotPos, int K, EarleyItem *predecessor, EarleyItem *child, int lexState = 0);   ///< appends an item to the given ItemList (index), a duplicate only adds its derivation to the forest
     bool checkSuccessful();                                                                         ///< checks wheter parsing was successful or not
+    void invalidateLexiconWord(const QString &lexiconWord, int pathLength);                         ///< marks the item sets that scanned the changed part of a lexicon word, pathLength characters of it were in the trie before
+    void updateNullable();                                                                          ///< computes which nonTerminals derive the empty word
     EarleySymbol addNonTerminal(QString nonTerminal);                                               ///< checks for duplicates and adds a NonTerminal, return NonTerminal-Index
-    void backtraceTree(EarleyItemList *tree);                                                                           ///< backtraces the items to produce a tree
+    bool convertConclusion(QString conclusio, QVector<EarleySymbol> *conclusion, bool addUnknown);  ///< converts the right side of a rule to symbols, returns false on unknown nonTerminals if addUnknown is not set
+    QVector<int> resolveActions(const QStringList &functions) const;                                ///< converts function names to action codes
+    static QByteArray ruleKey(EarleySymbol premise, const QVector<EarleySymbol> &conclusion);       ///< key of a rule in the rule index
+    void compactRules(int index);                                                                   ///< drops the removed rules of a nonTerminal and updates the rule index
+    static void initializeTerminalClasses();                                                        ///< fills the wildcard lookup tables once
+    void backtraceTree(EarleyItemList *tree);                                                       ///< walks the parse forest from the completed start item to produce a tree
+    EarleyPackedNode chooseDerivation(EarleyItem *item);                                            ///< returns the derivation of an item selected by the disambiguation policy
 signals:
 
 public slots:
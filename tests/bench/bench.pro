@@ -0,0 +1,11 @@
+# benchmarks of the calculator core, run with ./tst_phyxbenchmark -iterations 100 or -callgrind
+
+include(../core.pri)
+
+# the debug build logs every action of the calculator, which would be measured instead of the actions
+CONFIG -= debug
+CONFIG += release
+
+TARGET = tst_phyxbenchmark
+
+SOURCES += tst_phyxbenchmark.cpp
@@ -0,0 +1,300 @@
+/**************************************************************************
+**
+** This file is part of PhyxCalc.
+**
+** PhyxCalc is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** PhyxCalc is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with PhyxCalc.  If not, see <http://www.gnu.org/licenses/>.
+**
+***************************************************************************/
+
+#include <QtTest>
+#include <iomanip>
+#include "phyxcalculator.h"
+
+/// benchmarks of the calculator core, each benchmark prints the time of one iteration
+class tst_PhyxBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QString repeatedExpression(QString part, QString end, int length);   ///< repeats part until the expression has the given length
+    static QString nestedExpression(int length);                                ///< returns 1 in as many parentheses as fit into length
+    void benchmarkParse(QString expression);                                    ///< measures a parse of the whole expression
+
+private slots:
+    void parseExpression_data();
+    void parseExpression();
+    void parseRecursion_data();
+    void parseRecursion();
+    void dispatch_data();
+    void dispatch();
+    void parseLiteral_data();
+    void parseLiteral();
+    void formatLiteral_data();
+    void formatLiteral();
+    void datasetSweep_data();
+    void datasetSweep();
+    void floatBackend_data();
+    void floatBackend();
+};
+
+QString tst_PhyxBenchmark::repeatedExpression(QString part, QString end, int length)
+{
+    QString expression;
+    while (expression.size() + part.size() + end.size() <= length)
+        expression.append(part);
+    expression.append(end);
+    return expression;
+}
+
+QString tst_PhyxBenchmark::nestedExpression(int length)
+{
+    int depth = (length - 1) / 2;
+    return QString(depth, QChar('(')) + "1" + QString(depth, QChar(')'));
+}
+
+void tst_PhyxBenchmark::parseExpression_data()
+{
+    QTest::addColumn<QString>("expression");
+
+    QTest::newRow("mixed 200") << repeatedExpression("(1.5+2)*3^2-4/5+", "1", 200);
+    QTest::newRow("functions 200") << repeatedExpression("sin(0.5)*cos(2)+", "1", 200);
+}
+
+void tst_PhyxBenchmark::benchmarkParse(QString expression)
+{
+    PhyxCalculator calculator;
+    QVERIFY(calculator.setExpression(expression));
+
+    QBENCHMARK {
+        calculator.setExpression(QString());        // clears the item sets, the whole expression is parsed again
+        calculator.setExpression(expression);
+    }
+}
+
+void tst_PhyxBenchmark::parseExpression()
+{
+    QFETCH(QString, expression);
+    benchmarkParse(expression);
+}
+
+void tst_PhyxBenchmark::parseRecursion_data()
+{
+    QTest::addColumn<QString>("expression");
+
+    // right recursive and nested rules, the time should grow linearly with the length
+    QTest::newRow("sum 100") << repeatedExpression("1+", "1", 100);
+    QTest::newRow("sum 1000") << repeatedExpression("1+", "1", 1000);
+    QTest::newRow("sum 10000") << repeatedExpression("1+", "1", 10000);
+    QTest::newRow("parentheses 100") << nestedExpression(100);
+    QTest::newRow("parentheses 1000") << nestedExpression(1000);
+    QTest::newRow("parentheses 10000") << nestedExpression(10000);
+}
+
+void tst_PhyxBenchmark::parseRecursion()
+{
+    QFETCH(QString, expression);
+    benchmarkParse(expression);
+}
+
+void tst_PhyxBenchmark::dispatch_data()
+{
+    QTest::addColumn<QString>("operation");
+
+    QTest::newRow("add") << "+";
+    QTest::newRow("multiply") << "*";
+    QTest::newRow("power") << "^";
+}
+
+void tst_PhyxBenchmark::dispatch()
+{
+    QFETCH(QString, operation);
+
+    // the body of a compiled function runs without parsing, so the time per call is the time of its actions
+    const int operationCount = 1000;
+    const int callCount = 1000;
+    QString body = "x";
+    for (int i = 0; i < operationCount; i++)
+        body.append(operation + "x");
+
+    PhyxCalculator calculator;
+    QVERIFY(calculator.setExpression("bench(x)=" + body));
+    QVERIFY(calculator.evaluate());
+    QVERIFY(calculator.setExpression("bench(1)"));
+    QVERIFY(calculator.evaluate());     // compiles the function
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < callCount; i++)
+        calculator.evaluate();
+    QTest::setBenchmarkResult(static_cast<qreal>(timer.nsecsElapsed()) / (static_cast<qreal>(callCount) * operationCount),
+                              QTest::WalltimeNanoseconds);      // per operation of the body
+}
+
+void tst_PhyxBenchmark::parseLiteral_data()
+{
+    QTest::addColumn<QString>("literal");
+    QTest::addColumn<bool>("stream");
+
+    // the stream rows measure the conversion every literal went through before
+    QTest::newRow("integer") << "42" << false;
+    QTest::newRow("integer stream") << "42" << true;
+    QTest::newRow("decimal") << "3.14159" << false;
+    QTest::newRow("decimal stream") << "3.14159" << true;
+    QTest::newRow("exponent") << "6.02214e23" << false;
+    QTest::newRow("exponent stream") << "6.02214e23" << true;
+    QTest::newRow("long") << "3.14159265358979323846264" << false;   // too many digits, takes the stream path as well
+    QTest::newRow("long stream") << "3.14159265358979323846264" << true;
+}
+
+void tst_PhyxBenchmark::parseLiteral()
+{
+    QFETCH(QString, literal);
+    QFETCH(bool, stream);
+
+    PhyxFloatDataType value = PHYX_FLOAT_NULL;
+    if (stream)
+    {
+        QBENCHMARK {
+            std::istringstream inStream(literal.toStdString());
+            inStream.imbue(std::locale::classic());
+            inStream >> value;
+        }
+    }
+    else
+    {
+        QBENCHMARK {
+            value = PhyxCalculator::stringToFloat(literal.constData(), literal.size());
+        }
+    }
+    QVERIFY(value != PHYX_FLOAT_NULL);
+}
+
+void tst_PhyxBenchmark::formatLiteral_data()
+{
+    QTest::addColumn<QString>("literal");
+    QTest::addColumn<int>("precision");
+    QTest::addColumn<QString>("format");
+    QTest::addColumn<bool>("stream");
+
+    QTest::newRow("g") << "3.14159265358979" << 12 << "g" << false;
+    QTest::newRow("g stream") << "3.14159265358979" << 12 << "g" << true;
+    QTest::newRow("f") << "1234.5678" << 4 << "f" << false;
+    QTest::newRow("f stream") << "1234.5678" << 4 << "f" << true;
+    QTest::newRow("e") << "6.02214e23" << 6 << "e" << false;
+    QTest::newRow("e stream") << "6.02214e23" << 6 << "e" << true;
+    QTest::newRow("complex") << "1.5+2.25i" << 12 << "g" << false;
+}
+
+void tst_PhyxBenchmark::formatLiteral()
+{
+    QFETCH(QString, literal);
+    QFETCH(int, precision);
+    QFETCH(QString, format);
+    QFETCH(bool, stream);
+
+    char numberFormat = format.at(0).toLatin1();
+    QString string;
+    if (literal.contains(QChar('+')))
+    {
+        // a complex number prints both components
+        QStringList components = literal.split(QChar('+'));
+        PhyxValueDataType number = PhyxCalculator::stringToComplex(components.at(0)) + PhyxCalculator::stringToComplex(components.at(1));
+        QBENCHMARK {
+            string = PhyxCalculator::complexToString(number, precision, numberFormat, "i");
+        }
+    }
+    else if (stream)
+    {
+        PhyxFloatDataType number = PhyxCalculator::stringToFloat(literal.constData(), literal.size());
+        QBENCHMARK {
+            std::ostringstream outStream;
+            outStream.imbue(std::locale::classic());
+            if (numberFormat == 'f')
+                outStream << std::fixed;
+            else if (numberFormat == 'e')
+                outStream << std::scientific;
+            outStream << std::setprecision(precision) << number;
+            string = QString::fromStdString(outStream.str());
+        }
+    }
+    else
+    {
+        PhyxFloatDataType number = PhyxCalculator::stringToFloat(literal.constData(), literal.size());
+        QBENCHMARK {
+            string = PhyxCalculator::floatToString(number, precision, numberFormat);
+        }
+    }
+    QVERIFY(!string.isEmpty());
+}
+
+void tst_PhyxBenchmark::datasetSweep_data()
+{
+    QTest::addColumn<QString>("function");
+
+    QTest::newRow("polynomial 1000000") << "x*x+2*x+1";
+    QTest::newRow("functions 1000000") << "sin(x)*exp(-x/1000000)";
+}
+
+void tst_PhyxBenchmark::datasetSweep()
+{
+    QFETCH(QString, function);
+
+    // one million samples, every iteration would add another dataset of that size, so it runs once
+    PhyxCalculator calculator;
+    QVERIFY(calculator.setExpression("data([" + function + "],x,1,1000000,1)"));
+    QBENCHMARK_ONCE {
+        calculator.evaluate();
+    }
+    QCOMPARE(calculator.datasets()->size(), 1);
+    QCOMPARE(calculator.datasets()->first()->data.at(1).size(), 1000000);
+}
+
+void tst_PhyxBenchmark::floatBackend_data()
+{
+    QTest::addColumn<QString>("expression");
+    QTest::addColumn<bool>("dataset");
+
+    // the rows are named after the size of PhyxFloatDataType, compare a default build with one using CONFIG+=phyx_double
+    QString size = QString::number(static_cast<int>(sizeof(PhyxFloatDataType)));
+    QTest::newRow(qPrintable("evaluate " + size + " byte float")) << "sin(0.5)*exp(-0.25)+sqrt(2)^3/7" << false;
+    QTest::newRow(qPrintable("dataset " + size + " byte float")) << "data([sin(x)*exp(-x/100000)+sqrt(x)],x,1,100000,1)" << true;
+}
+
+void tst_PhyxBenchmark::floatBackend()
+{
+    QFETCH(QString, expression);
+    QFETCH(bool, dataset);
+
+    PhyxCalculator calculator;
+    QVERIFY(calculator.setExpression(expression));
+    if (dataset)
+    {
+        // every iteration would add another dataset, so it runs once
+        QBENCHMARK_ONCE {
+            calculator.evaluate();
+        }
+        QCOMPARE(calculator.datasets()->size(), 1);
+    }
+    else
+    {
+        QBENCHMARK {
+            calculator.evaluate();
+        }
+        QVERIFY(!calculator.hasError());
+    }
+}
+
+QTEST_MAIN(tst_PhyxBenchmark)
+
+#include "tst_phyxbenchmark.moc"
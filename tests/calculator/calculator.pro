@@ -0,0 +1,7 @@
+# tests of the calculator core
+
+include(../core.pri)
+
+TARGET = tst_phyxcalculator
+
+SOURCES += tst_phyxcalculator.cpp
@@ -0,0 +1,265 @@
+/**************************************************************************
+**
+** This file is part of PhyxCalc.
+**
+** PhyxCalc is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** PhyxCalc is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with PhyxCalc.  If not, see <http://www.gnu.org/licenses/>.
+**
+***************************************************************************/
+
+#include <QtTest>
+#include "phyxcalculator.h"
+
+class tst_PhyxCalculator : public QObject
+{
+    Q_OBJECT
+
+private:
+    static bool calculate(PhyxCalculator *calculator, QString expression);     ///< parses and evaluates an expression, returns false on error
+    static bool fuzzyCompare(PhyxValueDataType value, PhyxValueDataType expected);    ///< compares both parts relative to the size of the expected value
+
+private slots:
+    void faculty_data();
+    void faculty();
+    void integerRange_data();
+    void integerRange();
+    void storedVariableConversion_data();
+    void storedVariableConversion();
+    void steadyStateAllocations();
+    void functionParameters();
+    void datasetBatch_data();
+    void datasetBatch();
+    void datasetChunks();
+    void datasetCancel();
+};
+
+bool tst_PhyxCalculator::calculate(PhyxCalculator *calculator, QString expression)
+{
+    return calculator->setExpression(expression) && calculator->evaluate() && !calculator->hasError();
+}
+
+bool tst_PhyxCalculator::fuzzyCompare(PhyxValueDataType value, PhyxValueDataType expected)
+{
+    PhyxFloatDataType tolerance = 1e-12 * qMax(PHYX_FLOAT_ONE, std::abs(expected));
+    return (std::fabs(value.real() - expected.real()) <= tolerance) && (std::fabs(value.imag() - expected.imag()) <= tolerance);
+}
+
+void tst_PhyxCalculator::faculty_data()
+{
+    QTest::addColumn<QString>("expression");
+    QTest::addColumn<int>("result");
+
+    // the faculty binds to the number before it, like in doc_en.txt
+    QTest::newRow("sum") << "2+3!" << 8;
+    QTest::newRow("parentheses") << "(2+3)!" << 120;
+    QTest::newRow("product") << "2*3!" << 12;
+}
+
+void tst_PhyxCalculator::faculty()
+{
+    QFETCH(QString, expression);
+    QFETCH(int, result);
+
+    PhyxCalculator calculator;
+    QVERIFY(calculate(&calculator, expression));
+    QCOMPARE(calculator.resultValue(), PhyxValueDataType(static_cast<PhyxFloatDataType>(result)));
+}
+
+void tst_PhyxCalculator::integerRange_data()
+{
+    QTest::addColumn<QString>("expression");
+    QTest::addColumn<qlonglong>("result");
+
+    // integers between 2^31 and 2^53 stay exact, also where long has 32 bits
+    QTest::newRow("add") << "3000000000+1" << Q_INT64_C(3000000001);
+    QTest::newRow("sub") << "3000000000-5000000000" << Q_INT64_C(-2000000000);
+    QTest::newRow("mul") << "3000000000*2" << Q_INT64_C(6000000000);
+    QTest::newRow("div") << "4294967296/2" << Q_INT64_C(2147483648);
+    QTest::newRow("pow") << "2^40" << Q_INT64_C(1099511627776);
+    QTest::newRow("neg") << "-3000000000" << Q_INT64_C(-3000000000);
+    QTest::newRow("limit") << "9007199254740991-1" << Q_INT64_C(9007199254740990);
+}
+
+void tst_PhyxCalculator::integerRange()
+{
+    QFETCH(QString, expression);
+    QFETCH(qlonglong, result);
+
+    PhyxCalculator calculator;
+    QVERIFY(calculate(&calculator, expression));
+    QCOMPARE(calculator.result()->valueType(), PhyxVariable::IntegerValue);
+    QCOMPARE(static_cast<qlonglong>(calculator.result()->toInt()), result);
+}
+
+void tst_PhyxCalculator::storedVariableConversion_data()
+{
+    QTest::addColumn<QString>("definition");
+    QTest::addColumn<QString>("conversion");
+    QTest::addColumn<double>("result");
+
+    // a loaded variable follows the scale and offset of a conversion like any other operand
+    QTest::newRow("scaled") << "distance=1.5km" << "distance->m" << 1500.0;
+    QTest::newRow("scaled back") << "distance=1500m" << "distance->km" << 1.5;
+    QTest::newRow("offset") << "temperature=20°C" << "temperature->K" << 293.15;
+    QTest::newRow("offset back") << "temperature=293.15K" << "temperature->°C" << 20.0;
+}
+
+void tst_PhyxCalculator::storedVariableConversion()
+{
+    QFETCH(QString, definition);
+    QFETCH(QString, conversion);
+    QFETCH(double, result);
+
+    PhyxCalculator calculator;
+    calculator.loadFile(":/settings/definitions.txt");
+    QVERIFY(calculate(&calculator, definition));
+    QVERIFY(calculate(&calculator, conversion));
+    QVERIFY(qAbs(static_cast<double>(calculator.resultValue().real()) - result) < 1e-9);
+    QVERIFY(calculator.resultValue().imag() == PHYX_FLOAT_NULL);
+
+    // converting the variable again gives the same value, the stored variable is not changed by the conversion
+    QVERIFY(calculate(&calculator, conversion));
+    QVERIFY(qAbs(static_cast<double>(calculator.resultValue().real()) - result) < 1e-9);
+}
+
+void tst_PhyxCalculator::steadyStateAllocations()
+{
+    PhyxCalculator calculator;
+
+    // the first evaluation fills the pool of stack variables, later ones take all operands from it
+    QVERIFY(calculate(&calculator, "1+2*3"));
+    int allocations = calculator.allocationCount();
+    QVERIFY(allocations > 0);
+
+    for (int i = 0; i < 3; i++)
+    {
+        QVERIFY(calculate(&calculator, "1+2*3"));
+        QCOMPARE(calculator.resultValue(), PhyxValueDataType(static_cast<PhyxFloatDataType>(7)));
+        QCOMPARE(calculator.allocationCount(), allocations);
+    }
+}
+
+void tst_PhyxCalculator::functionParameters()
+{
+    PhyxCalculator calculator;
+    QVERIFY(calculate(&calculator, "square(x)=x^2"));
+    QVERIFY(calculate(&calculator, "square(3)"));
+    QCOMPARE(calculator.resultValue(), PhyxValueDataType(static_cast<PhyxFloatDataType>(9)));
+
+    // the parameter is only known inside the body, not to the expressions of the calculator
+    QVERIFY(calculator.variable("x") == NULL);
+    QVERIFY(!calculate(&calculator, "x+1"));
+
+    QVERIFY(calculate(&calculator, "x=2"));
+    QVERIFY(calculate(&calculator, "square(4)+x"));
+    QCOMPARE(calculator.resultValue(), PhyxValueDataType(static_cast<PhyxFloatDataType>(18)));
+}
+
+void tst_PhyxCalculator::datasetBatch_data()
+{
+    QTest::addColumn<QString>("function");
+    QTest::addColumn<QString>("unit");
+    QTest::addColumn<double>("start");
+    QTest::addColumn<double>("stop");
+    QTest::addColumn<double>("step");
+
+    QTest::newRow("power") << "x^2" << "" << -2.0 << 2.0 << 0.5;
+    QTest::newRow("uniform left") << "2^x-1/x" << "" << 0.5 << 4.0 << 0.5;
+    QTest::newRow("uniform right") << "x/4-3" << "" << -2.0 << 2.0 << 0.5;
+    QTest::newRow("no pow") << "x^2^3" << "" << -2.0 << 2.0 << 0.5;
+    QTest::newRow("functions") << "sin(x)*exp(x)+ln(x)" << "" << 0.5 << 4.0 << 0.5;
+    QTest::newRow("scaled km") << "x*3+1m" << "km" << 1.0 << 3.0 << 0.25;
+    QTest::newRow("scaled min") << "x+30s" << "min" << 1.0 << 3.0 << 0.25;
+    QTest::newRow("scaled squared") << "x^2" << "min" << 1.0 << 3.0 << 0.25;
+    QTest::newRow("offset") << "x+1K" << "°C" << -20.0 << 20.0 << 5.0;
+    QTest::newRow("complex samples") << "sqrt(x)" << "" << -2.0 << 2.0 << 0.5;      // the batch falls back to single samples
+}
+
+void tst_PhyxCalculator::datasetBatch()
+{
+    QFETCH(QString, function);
+    QFETCH(QString, unit);
+    QFETCH(double, start);
+    QFETCH(double, stop);
+    QFETCH(double, step);
+
+    PhyxCalculator calculator;
+    calculator.loadFile(":/settings/definitions.txt");
+
+    QString range = QString("%1%4,%2%4,%3%4").arg(start).arg(stop).arg(step).arg(unit);
+    QVERIFY(calculate(&calculator, "data([" + function + "],x," + range + ")"));
+    QCOMPARE(calculator.datasets()->size(), 1);
+
+    // every sample of the dataset has to be the value of a single evaluation of the function
+    const PhyxVariableManager::PhyxDataset *dataset = calculator.datasets()->first();
+    int count = qRound((stop - start) / step) + 1;
+    QCOMPARE(dataset->data.size(), 2);
+    QCOMPARE(dataset->data.at(1).size(), count);
+
+    QVERIFY(calculate(&calculator, "reference(x)=" + function));
+    for (int i = 0; i < count; i++)
+    {
+        QVERIFY(calculate(&calculator, QString("reference((%1%2))").arg(start + i * step).arg(unit)));
+        QVERIFY2(fuzzyCompare(dataset->data.at(1).at(i), calculator.resultValue()),
+                 qPrintable(QString("sample %1").arg(i)));
+    }
+}
+
+void tst_PhyxCalculator::datasetChunks()
+{
+    // several chunks run on the worker pool, their results have to be merged in order
+    const int count = 3 * PHYX_DATASET_CHUNK_SIZE + 100;
+    PhyxCalculator calculator;
+    QVERIFY(calculate(&calculator, QString("data([x*x-3*x+sin(x)],x,1,%1,1)").arg(count)));
+    QCOMPARE(calculator.datasets()->size(), 1);
+
+    const PhyxVariableManager::PhyxDataset *dataset = calculator.datasets()->first();
+    QCOMPARE(dataset->data.at(0).size(), count);
+    QCOMPARE(dataset->data.at(1).size(), count);
+    for (int i = 0; i < count; i++)
+    {
+        PhyxFloatDataType x = static_cast<PhyxFloatDataType>(i + 1);
+        QCOMPARE(dataset->data.at(0).at(i), PhyxValueDataType(x));
+        QVERIFY2(fuzzyCompare(dataset->data.at(1).at(i), PhyxValueDataType(x * x - 3 * x + std::sin(x))),
+                 qPrintable(QString("sample %1").arg(i)));
+    }
+
+    // a single thread gives the same values, a dataset of one chunk is not split
+    PhyxCalculator singleCalculator;
+    QVERIFY(calculate(&singleCalculator, QString("data([x*x-3*x+sin(x)],x,%1,%2,1)").arg(count - PHYX_DATASET_CHUNK_SIZE + 1).arg(count)));
+    const PhyxVariableManager::PhyxDataset *singleDataset = singleCalculator.datasets()->first();
+    QCOMPARE(singleDataset->data.at(1).size(), PHYX_DATASET_CHUNK_SIZE);
+    for (int i = 0; i < PHYX_DATASET_CHUNK_SIZE; i++)
+        QCOMPARE(singleDataset->data.at(1).at(i), dataset->data.at(1).at(count - PHYX_DATASET_CHUNK_SIZE + i));
+}
+
+void tst_PhyxCalculator::datasetCancel()
+{
+    PhyxCalculator calculator;
+    connect(&calculator, SIGNAL(datasetProgress(int,int)), &calculator, SLOT(cancelDataset()));
+    QSignalSpy progressSpy(&calculator, SIGNAL(datasetProgress(int,int)));
+
+    calculate(&calculator, QString("data([x*x],x,1,%1,1)").arg(4 * PHYX_DATASET_CHUNK_SIZE));
+    QVERIFY(progressSpy.count() > 0);
+    QCOMPARE(calculator.datasets()->size(), 0);
+    QVERIFY(!calculator.isCalculatingDataset());
+
+    // the calculator works normally after a cancel
+    disconnect(&calculator, SIGNAL(datasetProgress(int,int)), &calculator, SLOT(cancelDataset()));
+    QVERIFY(calculate(&calculator, "data([x*x],x,1,10,1)"));
+    QCOMPARE(calculator.datasets()->size(), 1);
+}
+
+QTEST_MAIN(tst_PhyxCalculator)
+
+#include "tst_phyxcalculator.moc"
@@ -0,0 +1,40 @@
+# sources of the calculator core shared by the tests and benchmarks
+
+QT       += core gui testlib
+CONFIG   += c++11 testcase
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/..
+
+win32 | android | symbian {
+    INCLUDEPATH += $$PWD/../../boost
+}
+
+osx {
+    INCLUDEPATH += /opt/homebrew/Cellar/boost/1.83.0/include/
+}
+
+phyx_double {
+    DEFINES += PHYX_FLOAT_DOUBLE
+}
+
+SOURCES += $$PWD/../qearleyparser.cpp \
+    $$PWD/../phyxcalculator.cpp \
+    $$PWD/../phyxunit.cpp \
+    $$PWD/../phyxvariable.cpp \
+    $$PWD/../phyxunitsystem.cpp \
+    $$PWD/../phyxcompoundunit.cpp \
+    $$PWD/../phyxvariablemanager.cpp \
+    $$PWD/../phyxbatchplan.cpp
+
+HEADERS += $$PWD/../global.h \
+    $$PWD/../qearleyparser.h \
+    $$PWD/../phyxcalculator.h \
+    $$PWD/../phyxunit.h \
+    $$PWD/../phyxvariable.h \
+    $$PWD/../phyxunitsystem.h \
+    $$PWD/../phyxcompoundunit.h \
+    $$PWD/../phyxvariablemanager.h \
+    $$PWD/../phyxbatchplan.h
+
+RESOURCES += $$PWD/../settings.qrc
@@ -0,0 +1,12 @@
+# tests of the headless document evaluator
+
+include(../core.pri)
+
+TARGET = tst_phyxdocumentevaluator
+
+SOURCES += tst_phyxdocumentevaluator.cpp \
+    $$PWD/../../unitloader.cpp \
+    $$PWD/../../phyxdocumentevaluator.cpp
+
+HEADERS += $$PWD/../../unitloader.h \
+    $$PWD/../../phyxdocumentevaluator.h
@@ -0,0 +1,67 @@
+/**************************************************************************
+**
+** This file is part of PhyxCalc.
+**
+** PhyxCalc is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** PhyxCalc is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with PhyxCalc.  If not, see <http://www.gnu.org/licenses/>.
+**
+***************************************************************************/
+
+#include <QtTest>
+#include "phyxdocumentevaluator.h"
+
+class tst_PhyxDocumentEvaluator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void evaluateSheet();
+};
+
+void tst_PhyxDocumentEvaluator::evaluateSheet()
+{
+    UnitLoader unitLoader;
+    QVERIFY(unitLoader.loadSymbols(":/settings/"));
+
+    PhyxDocumentEvaluator evaluator;
+    evaluator.setUnitLoader(&unitLoader);
+
+    QStringList sheet;
+    sheet << "1+2"          // 0
+          << "α=4"          // 1
+          << "alpha*2"      // 2, names of symbols are replaced like in the editor
+          << "/* 5"         // 3
+          << "6"            // 4, inside the comment
+          << "*/"           // 5
+          << "=8"           // 6, result of an earlier evaluation
+          << "7";           // 7
+
+    QHash<int, PhyxValueDataType> results;
+    foreach (const PhyxDocumentEvaluator::LineOutput &output, evaluator.evaluate(sheet))
+    {
+        QVERIFY2(output.type != PhyxDocumentEvaluator::ErrorOutput, qPrintable(output.errorString));
+        if (output.type == PhyxDocumentEvaluator::ResultOutput)
+            results.insert(output.line, output.rawValue);
+    }
+
+    QCOMPARE(results.value(0), PhyxValueDataType(3));
+    QCOMPARE(results.value(2), PhyxValueDataType(8));
+    QCOMPARE(results.value(7), PhyxValueDataType(7));
+    QVERIFY(!results.contains(3));
+    QVERIFY(!results.contains(4));
+    QVERIFY(!results.contains(6));
+}
+
+QTEST_MAIN(tst_PhyxDocumentEvaluator)
+
+#include "tst_phyxdocumentevaluator.moc"
@@ -0,0 +1,7 @@
+# tests of the Earley parser
+
+include(../core.pri)
+
+TARGET = tst_qearleyparser
+
+SOURCES += tst_qearleyparser.cpp
@@ -0,0 +1,70 @@
+/**************************************************************************
+**
+** This file is part of PhyxCalc.
+**
+** PhyxCalc is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** PhyxCalc is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with PhyxCalc.  If not, see <http://www.gnu.org/licenses/>.
+**
+***************************************************************************/
+
+#include <QtTest>
+#include "qearleyparser.h"
+
+class tst_QEarleyParser : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void loadArithmetic(QEarleyParser *parser);      ///< loads a grammar of sums and products of integers
+
+private slots:
+    void steadyStateAllocations();
+};
+
+void tst_QEarleyParser::loadArithmetic(QEarleyParser *parser)
+{
+    parser->loadRule("S=|sum|", QStringList());
+    parser->loadRule("sum=|sum|+|product|", QStringList());
+    parser->loadRule("sum=|product|", QStringList());
+    parser->loadRule("product=|product|*|number|", QStringList());
+    parser->loadRule("product=|number|", QStringList());
+    parser->loadRule("number=|number||digit|", QStringList());
+    parser->loadRule("number=|digit|", QStringList());
+    for (char digit = '0'; digit <= '9'; digit++)
+        parser->loadRule(QString("digit=") + QChar(digit), QStringList());
+    parser->setStartSymbol("S");
+}
+
+void tst_QEarleyParser::steadyStateAllocations()
+{
+    QEarleyParser parser;
+    loadArithmetic(&parser);
+
+    // the first parse creates the item sets, later parses of the same size reuse them
+    QVERIFY(parser.parseWord("12+3*45+6"));
+    int allocations = parser.allocationCount();
+    QVERIFY(allocations > 0);
+
+    QVERIFY(parser.parseWord("12+3*45+6"));
+    QCOMPARE(parser.allocationCount(), allocations);
+
+    QVERIFY(parser.updateWord("12+3*45+7"));
+    QCOMPARE(parser.allocationCount(), allocations);
+
+    QVERIFY(parser.updateWord("12+3*45+6"));
+    QCOMPARE(parser.allocationCount(), allocations);
+}
+
+QTEST_MAIN(tst_QEarleyParser)
+
+#include "tst_qearleyparser.moc"
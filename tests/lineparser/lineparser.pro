@@ -0,0 +1,42 @@
+# tests of the line parser driving a calculation editor, they need the GUI and qwt like PhyxCalc
+
+include(../core.pri)
+
+QT       += svg
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
+
+TARGET = tst_lineparser
+
+win32 {
+    INCLUDEPATH += $$PWD/../../../qwt6/src
+    LIBS += -L$$PWD/../../../qwt6/lib
+}
+
+linux-g++ | linux-g++-64 | linux-g++-32 {
+    INCLUDEPATH += /usr/include/qwt5 \  #openSUSE
+                /usr/include/qwt6 \  #openSUSE
+                /usr/include/qwt \      #Fedora
+                /usr/include/qwt-qt4    #ubuntu
+}
+
+osx {
+    INCLUDEPATH += /opt/homebrew/Cellar/qwt-qt5/6.2.0/lib/qwt.framework/Versions/6/Headers
+    LIBS += -F"/opt/homebrew/Cellar/qwt-qt5/6.2.0/lib"
+    LIBS += -framework qwt
+}
+
+SOURCES += tst_lineparser.cpp \
+    $$PWD/../../lineparser.cpp \
+    $$PWD/../../unitloader.cpp \
+    $$PWD/../../phyxsyntaxhighlighter.cpp \
+    $$PWD/../../plotwindow.cpp \
+    $$PWD/../../plotdialog.cpp
+
+HEADERS += $$PWD/../../lineparser.h \
+    $$PWD/../../unitloader.h \
+    $$PWD/../../phyxsyntaxhighlighter.h \
+    $$PWD/../../plotwindow.h \
+    $$PWD/../../plotdialog.h
+
+FORMS += $$PWD/../../plotwindow.ui \
+    $$PWD/../../plotdialog.ui
@@ -0,0 +1,127 @@
+/**************************************************************************
+**
+** This file is part of PhyxCalc.
+**
+** PhyxCalc is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** PhyxCalc is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with PhyxCalc.  If not, see <http://www.gnu.org/licenses/>.
+**
+***************************************************************************/
+
+#include <QtTest>
+#include "lineparser.h"
+
+class tst_LineParser : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_LineParser() : calculator(NULL) {}
+
+private:
+    PhyxCalculator *calculator;     ///< the calculator of the line parser under test
+    QStringList     evaluated;      ///< the expressions that produced a result since the last clear
+
+    static QTextBlock findLine(QTextEdit *edit, QString text);                  ///< returns the first line with the text
+    static void replaceLine(QTextEdit *edit, QString text, QString newText);   ///< edits a line like a user would
+
+private slots:
+    void recordResult();
+    void dependentLines();
+};
+
+QTextBlock tst_LineParser::findLine(QTextEdit *edit, QString text)
+{
+    for (QTextBlock block = edit->document()->begin(); block.isValid(); block = block.next())
+    {
+        if (block.text() == text)
+            return block;
+    }
+    return QTextBlock();
+}
+
+void tst_LineParser::replaceLine(QTextEdit *edit, QString text, QString newText)
+{
+    QTextCursor textCursor(findLine(edit, text));
+    textCursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+    textCursor.insertText(newText);
+}
+
+void tst_LineParser::recordResult()
+{
+    evaluated.append(calculator->expression());
+}
+
+void tst_LineParser::dependentLines()
+{
+    AppSettings appSettings;
+    appSettings.output.numbers.decimalPrecision = 6;
+    appSettings.output.numbers.format = 'g';
+    appSettings.output.numbers.useFractions = false;
+    appSettings.output.unitMode = 1;
+    appSettings.output.imaginaryUnit = "i";
+    appSettings.output.prefixMode = 1;
+
+    UnitLoader unitLoader;
+    QVERIFY(unitLoader.loadSymbols(":/settings/"));
+
+    QTextEdit edit;
+    LineParser lineParser;      // stays loading, so the tables and the plot window are not needed
+    lineParser.setCalculationEdit(&edit);
+    lineParser.setAppSettings(&appSettings);
+    lineParser.setUnitLoader(&unitLoader);
+
+    calculator = lineParser.phyxCalculator();
+    connect(calculator, SIGNAL(outputResult()),
+            this, SLOT(recordResult()));
+
+    QStringList sheet;
+    sheet << "a=2"
+          << "a*3"
+          << "c=5"
+          << "c+1"
+          << "a+c";
+    edit.setPlainText(sheet.join("\n"));
+    lineParser.parseAll();
+    QCOMPARE(evaluated, QStringList() << "a*3" << "c+1" << "a+c");
+
+    // only the lines reading a are recalculated
+    evaluated.clear();
+    replaceLine(&edit, "a=2", "a=4");
+    lineParser.parseChanged();
+    QCOMPARE(evaluated, QStringList() << "a*3" << "a+c");
+    QCOMPARE(findLine(&edit, "a*3").next().text(), QString("=12"));
+    QCOMPARE(findLine(&edit, "a+c").next().text(), QString("=9"));
+
+    // nothing changed, nothing is recalculated
+    evaluated.clear();
+    lineParser.parseChanged();
+    QVERIFY(evaluated.isEmpty());
+
+    // a line turned into a comment drops its dependencies and is not visited again
+    replaceLine(&edit, "c+1", "//c+1");
+    lineParser.parseChanged();
+    QTextBlock commentLine = findLine(&edit, "//c+1");
+    QVERIFY(commentLine.isValid());
+    QVERIFY(commentLine.userData() == NULL);
+
+    evaluated.clear();
+    replaceLine(&edit, "c=5", "c=6");
+    lineParser.parseChanged();
+    QCOMPARE(evaluated, QStringList() << "a+c");
+    QCOMPARE(findLine(&edit, "a+c").next().text(), QString("=10"));
+    QVERIFY(commentLine.userData() == NULL);
+}
+
+QTEST_MAIN(tst_LineParser)
+
+#include "tst_lineparser.moc"
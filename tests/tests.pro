@@ -0,0 +1,10 @@
+# tests and benchmarks of the calculator core, only lineparser needs the GUI of PhyxCalc and qwt
+# build with qmake && make check, CONFIG+=phyx_double builds them for the double backend
+
+TEMPLATE = subdirs
+
+SUBDIRS += bench \
+    calculator \
+    documentevaluator \
+    earleyparser \
+    lineparser
@@ -108,3 +108,12 @@ bool UnitLoader::loadSymbols(QString directory)
     else
         return false;
 }
+
+QString UnitLoader::replaceSymbols(QString text) const
+{
+    for (int i = 0; i < symbolList.size(); i++)
+    {
+        text.replace(symbolList.at(i).name, symbolList.at(i).symbol, Qt::CaseSensitive);
+    }
+    return text;
+}
@@ -64,6 +64,7 @@ public:
         //QMap<QString, double>       *siPrefixes() {return &siPrefixMap;}
 
     bool loadSymbols(QString directory);
+    QString replaceSymbols(QString text) const;    ///< replaces the names of symbols, like alpha, with the symbols
 private:
     //QMap<QString, QString>     unitMap;
     QList<symbolStruct>                symbolList;